@@ -1,5 +1,8 @@
 #include "ihct.h"
 
+#include <time.h>
+#include <unistd.h>
+
 IHCT_TEST(arithmetic_addition_basic) {
     IHCT_ASSERT(1 + 2 == 3);
     IHCT_ASSERT(4 + 2 == 6);
@@ -18,6 +21,13 @@ IHCT_TEST(timeout_slow) {
     }
 }
 
+// Times out well before the default of 3 seconds.
+IHCT_TEST_TIMEOUT(timeout_quick, 50ms) {
+    for(;;) {
+        IHCT_CLOBBER();
+    }
+}
+
 IHCT_TEST(sigsegv_test) {
     int *p = NULL;
     *p = 3;
@@ -32,6 +42,13 @@ IHCT_TEST(strings_invalid) {
     IHCT_ASSERT_STR("Evil", "Good"); // should fail.
 }
 
+// Run only these with -f @slow, or leave them out with -f '!@slow'.
+IHCT_TEST_TAGGED(strings_many, "slow") {
+    for(int i = 0; i < 100000; i++) {
+        IHCT_ASSERT_STR("abc", "abc");
+    }
+}
+
 IHCT_TEST(strings_more) {
     IHCT_ASSERT_STR("aaa", "aaa");
     IHCT_ASSERT_STR("bbb", "bbb");
@@ -40,6 +57,121 @@ IHCT_TEST(strings_more) {
     IHCT_ASSERT_STR("eee", "eee");
 }
 
+// Only checked when passing --counters.
+IHCT_TEST(strings_length_cost) {
+    IHCT_ASSERT(strlen("a short string") == 14);
+    IHCT_ASSERT_MAX_INSTRUCTIONS(100000);
+}
+
+// Only checked when allocations are tracked; the example is linked with ihct_alloc.
+IHCT_TEST(memory_allocs) {
+    char *p = malloc(16);
+    IHCT_ASSERT_NO_ALLOC {
+        strcpy(p, "no allocation");
+    }
+    IHCT_ASSERT_MAX_ALLOCS(1);
+    free(p);
+}
+
+// Every row is a unit of its own; the last one fails on its own.
+static const struct { int a, b, sum; } sums[] = {{1, 2, 3}, {2, 2, 4}, {8, 8, 16}, {1, 1, 3}};
+IHCT_TEST_P(arithmetic_addition_table, typeof(sums[0]), sums) {
+    IHCT_ASSERT(row->a + row->b == row->sum);
+}
+
+// Checked for --cases random inputs.
+IHCT_PROPERTY(arithmetic_addition_commutes) {
+    long long a = IHCT_GEN_INT(-1000000, 1000000);
+    long long b = IHCT_GEN_INT(-1000000, 1000000);
+    IHCT_ASSERT(a + b == b + a);
+}
+
+// Fails, and is shrunk to the smallest string that fails it: "0".
+IHCT_PROPERTY(strings_without_digits) {
+    char *s = IHCT_GEN_STRING(20);
+    IHCT_ASSERT(strpbrk(s, "0123456789") == NULL);
+}
+
+// Set up once, by whichever of the tests below runs first, and shared by both.
+IHCT_FIXTURE(words, RUN) {
+    static const char *words[] = {"alfa", "bravo", "charlie", NULL};
+    return words;
+}
+
+IHCT_TEST(fixture_first_word) {
+    const char **words = IHCT_REQUIRE(words);
+    IHCT_ASSERT_STR(words[0], "alfa");
+}
+
+IHCT_TEST(fixture_last_word) {
+    const char **words = IHCT_REQUIRE(words);
+    IHCT_ASSERT_STR(words[2], "charlie");
+}
+
+// Typed assertions show the values compared when they fail.
+IHCT_TEST(arithmetic_typed) {
+    IHCT_ASSERT_LT_UINT(sizeof(int), sizeof(long long) + 1);
+    IHCT_ASSERT_NEAR_DBL(0.1 + 0.2, 0.3, 1e-12);
+    IHCT_ASSERT_EQ_DBL(0.1 + 0.2, 0.3, 0);
+}
+
+// Large buffers are compared at memory speed; differences are shown as a hexdump.
+IHCT_TEST(memory_compare) {
+    static unsigned char a[1 << 20], b[1 << 20];
+    for(size_t i = 0; i < sizeof(a); i++) a[i] = b[i] = i % 251;
+    b[1000] = 0;
+    IHCT_ASSERT_MEM(a, b, 1000);
+    IHCT_ASSERT_MEM(a, b, sizeof(a));
+}
+
+// Passes when run once, but fails every seventh run; see --repeat=100 --flaky-report.
+IHCT_TEST(arithmetic_flaky) {
+    static unsigned runs;
+    IHCT_ASSERT(__atomic_add_fetch(&runs, 1, __ATOMIC_RELAXED) % 7 != 0);
+}
+
+// Run on four threads at once; the counter only ever grows.
+static unsigned long counter;
+IHCT_TEST_CONCURRENT(counter_increments, 4, 100000) {
+    for(size_t i = 0; i < iterations; i++) {
+        unsigned long before = __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+        IHCT_ASSERT(__atomic_load_n(&counter, __ATOMIC_RELAXED) > before);
+    }
+}
+
+// Retries with a doubling delay. Sleeps for a minute in all, which with virtual
+// time takes no time at all; the example is linked with ihct_time.
+static int retry_with_backoff(int (*attempt)(void), int attempts) {
+    unsigned delay = 1;
+    for(int i = 0; i < attempts; i++, delay *= 2) {
+        if(attempt() == 0) return 0;
+        sleep(delay);
+    }
+    return -1;
+}
+
+static int attempt_fails(void) {
+    return -1;
+}
+
+IHCT_TEST_VIRTUAL_TIME(time_backoff) {
+    time_t before = time(NULL);
+    IHCT_ASSERT(retry_with_backoff(&attempt_fails, 6) == -1);
+    IHCT_ASSERT_EQ_INT(time(NULL) - before, 1 + 2 + 4 + 8 + 16 + 32);
+    IHCT_TIME_ADVANCE(60);
+    IHCT_ASSERT_EQ_INT(time(NULL) - before, 123);
+}
+
+// Only run when passing -b.
+IHCT_BENCH(strings_compare) {
+    char a[64] = "a string that is long enough to be compared";
+    char b[64] = "a string that is long enough to be compared";
+    IHCT_BENCH_BYTES(strlen(a));
+    for(size_t i = 0; i < iterations; i++) {
+        IHCT_DO_NOT_OPTIMIZE(strcmp(a, b));
+    }
+}
+
 int main(int argc, char **argv) {
     return IHCT_RUN(argc, argv);
 }
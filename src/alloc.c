@@ -0,0 +1,172 @@
+#include "alloc.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <malloc.h>
+
+// The allocator of glibc, under the names it keeps for wrappers like this one.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void __libc_free(void *p);
+
+// Tracking state of a thread. Only ever touched by its own thread, so there is
+// no locking. Blocks allocated while tracking are kept in an open addressed
+// hash set, to tell leaks apart from frees of memory allocated before the unit.
+typedef struct {
+    bool tracking;
+    ihct_alloc_stats stats;
+    void **live;
+    size_t live_count;
+    size_t live_cap;
+    unsigned long long live_bytes;
+} ihct_alloc_state;
+
+// Initial-exec keeps access to the state a plain offset from the thread
+// pointer, instead of a call into the dynamic linker on every allocation.
+static __thread ihct_alloc_state state __attribute__((tls_model("initial-exec")));
+
+static size_t ihct_alloc_slot(const ihct_alloc_state *s, const void *p) {
+    uintptr_t h = (uintptr_t)p;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h & (s->live_cap - 1);
+}
+
+static void ihct_alloc_insert(ihct_alloc_state *s, void *p);
+
+static void ihct_alloc_grow(ihct_alloc_state *s) {
+    void **old = s->live;
+    size_t old_cap = s->live_cap;
+
+    size_t cap = old_cap ? old_cap * 2 : 256;
+    void **live = __libc_calloc(cap, sizeof(void *));
+    // Without room to remember blocks, leaks are just not found.
+    if(!live) return;
+    s->live = live;
+    s->live_cap = cap;
+    s->live_count = 0;
+    for(size_t i = 0; i < old_cap; i++) {
+        if(old[i]) ihct_alloc_insert(s, old[i]);
+    }
+    __libc_free(old);
+}
+
+static void ihct_alloc_insert(ihct_alloc_state *s, void *p) {
+    // Kept at most half full.
+    if((s->live_count + 1) * 2 > s->live_cap) ihct_alloc_grow(s);
+    if((s->live_count + 1) * 2 > s->live_cap) return;
+
+    size_t i = ihct_alloc_slot(s, p);
+    while(s->live[i]) i = (i + 1) & (s->live_cap - 1);
+    s->live[i] = p;
+    s->live_count++;
+}
+
+// Removes p, and returns whether it was there.
+static bool ihct_alloc_remove(ihct_alloc_state *s, void *p) {
+    if(!s->live_count) return false;
+
+    size_t mask = s->live_cap - 1;
+    size_t i = ihct_alloc_slot(s, p);
+    while(s->live[i] != p) {
+        if(!s->live[i]) return false;
+        i = (i + 1) & mask;
+    }
+
+    // Shift the following entries of the probe sequence back, so no entry is
+    // left unreachable behind the hole.
+    size_t j = i;
+    for(;;) {
+        s->live[i] = NULL;
+        for(;;) {
+            j = (j + 1) & mask;
+            if(!s->live[j]) {
+                s->live_count--;
+                return true;
+            }
+            size_t k = ihct_alloc_slot(s, s->live[j]);
+            // Entry j may move to i if its home slot k is not within (i, j].
+            if(i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+            break;
+        }
+        s->live[i] = s->live[j];
+        i = j;
+    }
+}
+
+static void ihct_alloc_track(void *p) {
+    if(!p || !state.tracking) return;
+    size_t size = malloc_usable_size(p);
+    state.stats.allocs++;
+    state.stats.bytes += size;
+    state.live_bytes += size;
+    ihct_alloc_insert(&state, p);
+}
+
+// Forgets the block p of the given size, which is about to be freed.
+static void ihct_alloc_untrack(void *p, size_t size) {
+    if(!p || !state.tracking) return;
+    state.stats.frees++;
+    if(ihct_alloc_remove(&state, p)) state.live_bytes -= size;
+}
+
+// The size of p, if it might be tracked. Has to be taken before it is freed.
+static size_t ihct_alloc_size(void *p) {
+    return p && state.tracking ? malloc_usable_size(p) : 0;
+}
+
+void *malloc(size_t size) {
+    void *p = __libc_malloc(size);
+    ihct_alloc_track(p);
+    return p;
+}
+
+void *calloc(size_t n, size_t size) {
+    void *p = __libc_calloc(n, size);
+    ihct_alloc_track(p);
+    return p;
+}
+
+void *realloc(void *p, size_t size) {
+    size_t old = ihct_alloc_size(p);
+    void *q = __libc_realloc(p, size);
+    // A failed realloc leaves the block as it was.
+    if(q || !size) ihct_alloc_untrack(p, old);
+    ihct_alloc_track(q);
+    return q;
+}
+
+void free(void *p) {
+    ihct_alloc_untrack(p, ihct_alloc_size(p));
+    __libc_free(p);
+}
+
+void ihct_alloc_begin(void) {
+    memset(&state.stats, 0, sizeof(state.stats));
+    if(state.live) memset(state.live, 0, state.live_cap * sizeof(void *));
+    state.live_count = 0;
+    state.live_bytes = 0;
+    state.tracking = true;
+}
+
+void ihct_alloc_read(ihct_alloc_stats *stats) {
+    *stats = state.stats;
+    stats->leaked = state.live_count;
+    stats->leaked_bytes = state.live_bytes;
+}
+
+void ihct_alloc_pause(void) {
+    state.tracking = false;
+}
+
+void ihct_alloc_resume(void) {
+    state.tracking = true;
+}
+
+void ihct_alloc_end(ihct_alloc_stats *stats) {
+    state.tracking = false;
+    ihct_alloc_read(stats);
+}
@@ -0,0 +1,34 @@
+#ifndef IHCT_ALLOC_H
+#define IHCT_ALLOC_H
+
+// Heap allocation tracking. The library ihct_alloc replaces malloc, calloc,
+// realloc and free, and counts the calls made by the thread running a unit.
+// Link a test program with it, or preload it (LD_PRELOAD), to track it; the
+// runner finds the functions below at runtime, and does without them. Aligned
+// allocations (posix_memalign and the like) are not counted.
+
+// Allocations made by a unit. Blocks allocated by the unit and not freed by the
+// same thread before it returned are leaked.
+typedef struct {
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long long bytes;
+    unsigned long leaked;
+    unsigned long long leaked_bytes;
+} ihct_alloc_stats;
+
+// Zeroes the counters of the calling thread, and starts tracking it.
+void ihct_alloc_begin(void);
+
+// Stops tracking the calling thread, and gets its counts since ihct_alloc_begin.
+void ihct_alloc_end(ihct_alloc_stats *stats);
+
+// Gets the counts of the calling thread so far, without stopping.
+void ihct_alloc_read(ihct_alloc_stats *stats);
+
+// Pauses and resumes tracking the calling thread, keeping its counts. Fixtures
+// are set up with tracking paused, since they outlive the unit setting them up.
+void ihct_alloc_pause(void);
+void ihct_alloc_resume(void);
+
+#endif
@@ -0,0 +1,83 @@
+#include "baseline.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// A baseline is a text file with one line per benchmark: its name, the number
+// of samples, and the samples themselves.
+
+static int ihct_baseline_cmp(const void *a, const void *b) {
+    return strcmp(((const ihct_baseline_entry *)a)->name,
+                  ((const ihct_baseline_entry *)b)->name);
+}
+
+bool ihct_baseline_load(ihct_baseline *b, const char *path) {
+    b->entries = NULL;
+    b->count = 0;
+
+    FILE *f = fopen(path, "r");
+    if(!f) return false;
+
+    size_t cap = 0;
+    char name[1024];
+    unsigned n;
+    while(fscanf(f, "%1023s %u", name, &n) == 2) {
+        // A count past any run is a corrupt file, not one to allocate for.
+        double *samples = n <= IHCT_BASELINE_MAX_SAMPLES ?
+            malloc((n ? n : 1) * sizeof(*samples)) : NULL;
+        char *copy = samples ? strdup(name) : NULL;
+        if(!copy) {
+            free(samples);
+            fclose(f);
+            ihct_baseline_free(b);
+            return false;
+        }
+        unsigned read = 0;
+        while(read < n && fscanf(f, "%lf", &samples[read]) == 1) read++;
+
+        if(b->count == cap) {
+            size_t grown = cap ? cap * 2 : 16;
+            ihct_baseline_entry *entries = realloc(b->entries, grown * sizeof(*entries));
+            if(!entries) {
+                free(samples);
+                free(copy);
+                fclose(f);
+                ihct_baseline_free(b);
+                return false;
+            }
+            b->entries = entries;
+            cap = grown;
+        }
+        b->entries[b->count++] = (ihct_baseline_entry){copy, read, samples};
+        if(read < n) break;
+    }
+    fclose(f);
+
+    qsort(b->entries, b->count, sizeof(*b->entries), ihct_baseline_cmp);
+    return true;
+}
+
+const ihct_baseline_entry *ihct_baseline_find(const ihct_baseline *b, const char *name) {
+    if(!b->count) return NULL;
+    ihct_baseline_entry key = {(char *)name, 0, NULL};
+    return bsearch(&key, b->entries, b->count, sizeof(*b->entries), ihct_baseline_cmp);
+}
+
+void ihct_baseline_append(ihct_strbuf *out, const char *name, const double *samples,
+                          unsigned sample_count) {
+    ihct_strbuf_appendf(out, "%s %u", name, sample_count);
+    for(unsigned i = 0; i < sample_count; i++) {
+        ihct_strbuf_appendf(out, " %.17g", samples[i]);
+    }
+    ihct_strbuf_append(out, "\n");
+}
+
+void ihct_baseline_free(ihct_baseline *b) {
+    for(size_t i = 0; i < b->count; i++) {
+        free(b->entries[i].name);
+        free(b->entries[i].samples);
+    }
+    free(b->entries);
+    b->entries = NULL;
+    b->count = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef IHCT_BASELINE_H
+#define IHCT_BASELINE_H
+
+#include "strbuf.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Most samples a benchmark in a baseline may have; any more and the baseline
+// is taken to be corrupt.
+#define IHCT_BASELINE_MAX_SAMPLES (1u << 20)
+
+// The samples of a benchmark in a baseline, in nanoseconds per iteration.
+typedef struct {
+    char *name;
+    unsigned sample_count;
+    double *samples;
+} ihct_baseline_entry;
+
+// Datatype representing a set of saved benchmark results to compare against.
+// To be used internally in IHCT_RUN.
+typedef struct {
+    ihct_baseline_entry *entries;
+    size_t count;
+} ihct_baseline;
+
+// Loads a baseline from the file at path. Returns false if it couldn't be read.
+bool ihct_baseline_load(ihct_baseline *b, const char *path);
+
+// Finds the entry of the named benchmark, or NULL if it isn't in the baseline.
+const ihct_baseline_entry *ihct_baseline_find(const ihct_baseline *b, const char *name);
+
+// Appends the line saving a benchmark to out. Written to a file, the lines
+// make up a baseline.
+void ihct_baseline_append(ihct_strbuf *out, const char *name, const double *samples,
+                          unsigned sample_count);
+
+// Deallocates the baseline.
+void ihct_baseline_free(ihct_baseline *b);
+
+#endif
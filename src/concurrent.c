@@ -0,0 +1,229 @@
+#define _GNU_SOURCE
+#include "concurrent.h"
+#include "strbuf.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct ihct_concurrent_state ihct_concurrent_state;
+
+struct ihct_concurrent_thread {
+    ihct_concurrent_state *state;
+    pthread_t tid;
+    unsigned index;
+    uint64_t seed;
+    ihct_test_result result;
+    // Seconds from being released until the body returned, or 0 if it didn't.
+    double elapsed;
+    // How many threads failed before this one, if it failed.
+    unsigned failed_after;
+};
+
+// Shared by the threads of a unit. The threads wait at the barrier until the
+// last one arrives, which releases them all.
+struct ihct_concurrent_state {
+    const ihct_unit *unit;
+    unsigned count;
+    ihct_concurrent_thread *threads;
+    // Threads actually started, to be joined.
+    unsigned started;
+    void (*guard)(ihct_concurrent_thread *t, void *arg);
+    void *arg;
+    unsigned ready;
+    bool released;
+    // Set if not every thread could be started; the others are released
+    // without running the body.
+    bool aborted;
+    unsigned failures;
+};
+
+// Next cpu to pin a thread to. Moves on with every unit, so units running side
+// by side are spread over the cpus.
+static unsigned next_cpu;
+
+static uint64_t ihct_concurrent_mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static void ihct_concurrent_relax(unsigned *spins) {
+    if(++*spins < IHCT_CONCURRENT_SPINS) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        sched_yield();
+    }
+}
+
+void ihct_concurrent_body(ihct_concurrent_thread *t) {
+    ihct_concurrent_state *s = t->state;
+    if(__atomic_add_fetch(&s->ready, 1, __ATOMIC_ACQ_REL) == s->count) {
+        __atomic_store_n(&s->released, true, __ATOMIC_RELEASE);
+    }
+    unsigned spins = 0;
+    while(!__atomic_load_n(&s->released, __ATOMIC_ACQUIRE)) ihct_concurrent_relax(&spins);
+    if(__atomic_load_n(&s->aborted, __ATOMIC_ACQUIRE)) return;
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    (*s->unit->concurrent)(&t->result, t->index, t->seed, s->unit->iterations);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    t->elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+}
+
+ihct_test_result *ihct_concurrent_result(ihct_concurrent_thread *t) {
+    return &t->result;
+}
+
+static void *ihct_concurrent_routine(void *arg) {
+    ihct_concurrent_thread *t = arg;
+    ihct_concurrent_state *s = t->state;
+    // Canceled right away along with the worker, if the unit times out.
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    (*s->guard)(t, s->arg);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    if(t->result.status != PASS) {
+        t->failed_after = __atomic_fetch_add(&s->failures, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void ihct_concurrent_free(ihct_concurrent_state *s) {
+    for(unsigned k = 0; k < s->count; k++) {
+        ihct_test_result *r = &s->threads[k].result;
+        if(r->status == ERR) free(r->code);
+        free(r->detail);
+    }
+    free(s->threads);
+    free(s);
+}
+
+// Stops every thread of a unit given up on, as the worker running it is.
+static void ihct_concurrent_cancel(void *arg) {
+    ihct_concurrent_state *s = arg;
+    for(unsigned k = 0; k < s->started; k++) pthread_cancel(s->threads[k].tid);
+    for(unsigned k = 0; k < s->started; k++) pthread_join(s->threads[k].tid, NULL);
+    ihct_concurrent_free(s);
+}
+
+// Starts every thread, pinned to a cpu each if there are enough of them.
+static void ihct_concurrent_start(ihct_concurrent_state *s) {
+    int cpus[CPU_SETSIZE];
+    cpu_set_t allowed;
+    unsigned cpu_count = 0;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for(int c = 0; c < CPU_SETSIZE; c++) {
+            if(CPU_ISSET(c, &allowed)) cpus[cpu_count++] = c;
+        }
+    }
+    unsigned first = __atomic_fetch_add(&next_cpu, s->count, __ATOMIC_RELAXED);
+
+    for(unsigned k = 0; k < s->count; k++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if(cpu_count >= s->count) {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpus[(first + k) % cpu_count], &one);
+            pthread_attr_setaffinity_np(&attr, sizeof(one), &one);
+        }
+        int err = pthread_create(&s->threads[k].tid, &attr, &ihct_concurrent_routine,
+                                 &s->threads[k]);
+        pthread_attr_destroy(&attr);
+        if(err) {
+            // Let the threads started go, without running the body.
+            __atomic_store_n(&s->aborted, true, __ATOMIC_RELEASE);
+            __atomic_store_n(&s->released, true, __ATOMIC_RELEASE);
+            return;
+        }
+        s->started++;
+    }
+}
+
+// Hands the result of the thread failing first over to the unit, noting which
+// thread it was.
+static void ihct_concurrent_result_of(ihct_concurrent_state *s, ihct_test_result *result,
+                                      uint64_t run_seed) {
+    ihct_concurrent_thread *first = NULL;
+    for(unsigned k = 0; k < s->count; k++) {
+        ihct_concurrent_thread *t = &s->threads[k];
+        if(t->result.status != PASS && (!first || t->failed_after < first->failed_after)) {
+            first = t;
+        }
+    }
+    *result = (ihct_test_result){.status = PASS};
+    if(!first) return;
+    *result = first->result;
+    first->result = (ihct_test_result){.status = PASS};
+
+    ihct_strbuf detail;
+    ihct_strbuf_init(&detail);
+    if(result->detail) ihct_strbuf_appendf(&detail, "%s\n", result->detail);
+    ihct_strbuf_appendf(&detail, "thread %u of %u failed first (seed %#llx)", first->index,
+                        s->count, (unsigned long long)first->seed);
+    if(s->failures > 1) ihct_strbuf_appendf(&detail, ", %u failed", s->failures);
+    ihct_strbuf_appendf(&detail, "; replay with --seed=%#llx", (unsigned long long)run_seed);
+    free(result->detail);
+    result->detail = detail.data;
+}
+
+void ihct_concurrent_run(const ihct_unit *unit, ihct_test_result *result, uint64_t seed,
+                         uint64_t run_seed, ihct_concurrent_stats *stats,
+                         void (*guard)(ihct_concurrent_thread *t, void *arg), void *arg) {
+    // Nothing is to be left behind by the worker being canceled midway.
+    int cancel_state;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+
+    ihct_concurrent_state *s = calloc(1, sizeof(*s));
+    unsigned count = unit->threads ? unit->threads : 1;
+    if(s) s->threads = calloc(count, sizeof(*s->threads));
+    if(!s || !s->threads) {
+        printf("Couldn't allocate memory for threads.\n");
+        exit(EXIT_FAILURE);
+    }
+    s->unit = unit;
+    s->count = count;
+    s->guard = guard;
+    s->arg = arg;
+    for(unsigned k = 0; k < count; k++) {
+        ihct_concurrent_thread *t = &s->threads[k];
+        t->state = s;
+        t->index = k;
+        t->seed = ihct_concurrent_mix(seed ^ (k * 0xd1342543de82ef95ULL));
+        t->result.status = PASS;
+    }
+    ihct_concurrent_start(s);
+
+    pthread_cleanup_push(&ihct_concurrent_cancel, s);
+    pthread_setcancelstate(cancel_state, NULL);
+    for(unsigned k = 0; k < s->started; k++) pthread_join(s->threads[k].tid, NULL);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    pthread_cleanup_pop(false);
+
+    stats->threads = count;
+    stats->iterations = unit->iterations;
+    stats->rates = malloc(count * sizeof(double));
+    if(!stats->rates) {
+        printf("Couldn't allocate memory for threads.\n");
+        exit(EXIT_FAILURE);
+    }
+    for(unsigned k = 0; k < count; k++) {
+        const ihct_concurrent_thread *t = &s->threads[k];
+        bool done = t->elapsed > 0 && t->result.status == PASS;
+        stats->rates[k] = done ? unit->iterations / t->elapsed : 0;
+    }
+    if(s->aborted) {
+        *result = (ihct_test_result){.status = ERR, .code = strdup("couldn't start threads")};
+    } else {
+        ihct_concurrent_result_of(s, result, run_seed);
+    }
+    ihct_concurrent_free(s);
+    pthread_setcancelstate(cancel_state, NULL);
+}
@@ -0,0 +1,41 @@
+#ifndef IHCT_CONCURRENT_H
+#define IHCT_CONCURRENT_H
+
+#include "ihct.h"
+
+#include <stdint.h>
+
+// Times a thread spins at the start barrier before yielding its cpu between
+// tries, for when there are more threads than cpus.
+#define IHCT_CONCURRENT_SPINS 4096
+
+// How a concurrent unit ran: the operations per second of every thread, from
+// being released until its body returned. A thread that failed is rated 0, as
+// it didn't do all of them.
+typedef struct {
+    unsigned threads;
+    size_t iterations;
+    double *rates;
+} ihct_concurrent_stats;
+
+// A thread running the body of a concurrent unit.
+typedef struct ihct_concurrent_thread ihct_concurrent_thread;
+
+// Runs the body of a thread, once every thread is started. To be called by the
+// guard given to ihct_concurrent_run.
+void ihct_concurrent_body(ihct_concurrent_thread *t);
+
+// The result of a thread, for its guard to fail it if the body crashed.
+ihct_test_result *ihct_concurrent_result(ihct_concurrent_thread *t);
+
+// Runs a concurrent unit: its body on unit->threads threads at once, pinned to
+// a cpu each if there are enough, each given its index and a seed of its own
+// drawn from seed. Every thread calls guard with arg, which calls
+// ihct_concurrent_body, and may keep the thread from taking the run down with
+// it. The result is that of the thread failing first, which its detail names.
+// The rates of the stats are allocated.
+void ihct_concurrent_run(const ihct_unit *unit, ihct_test_result *result, uint64_t seed,
+                         uint64_t run_seed, ihct_concurrent_stats *stats,
+                         void (*guard)(ihct_concurrent_thread *t, void *arg), void *arg);
+
+#endif
@@ -0,0 +1,123 @@
+#include "counters.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} ihct_counter_events[IHCT_COUNTER_COUNT] = {
+    [IHCT_COUNTER_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    [IHCT_COUNTER_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    [IHCT_COUNTER_CACHE_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses"},
+    [IHCT_COUNTER_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-misses"},
+    [IHCT_COUNTER_TASK_CLOCK] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task-clock"},
+};
+
+// Layout of a read of the hardware group.
+struct ihct_group_read {
+    uint64_t nr;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    struct {
+        uint64_t value;
+        uint64_t id;
+    } values[IHCT_COUNTER_COUNT];
+};
+
+static int ihct_counter_open(int event, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = ihct_counter_events[event].type;
+    attr.config = ihct_counter_events[event].config;
+    // Members of the group follow their leader, which starts out disabled.
+    attr.disabled = group < 0;
+    // Only user space is counted; the kernel is off limits to most users.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+bool ihct_counters_open(ihct_counters *c) {
+    for(int e = 0; e < IHCT_COUNTER_COUNT; e++) c->fds[e] = -1;
+
+    // The hardware events are read together, so they are counted over the
+    // same time. Without the leader (no PMU), there is no group at all.
+    int leader = ihct_counter_open(IHCT_COUNTER_INSTRUCTIONS, -1);
+    if(leader >= 0) {
+        c->fds[IHCT_COUNTER_INSTRUCTIONS] = leader;
+        for(int e = IHCT_COUNTER_CYCLES; e <= IHCT_COUNTER_BRANCH_MISSES; e++) {
+            c->fds[e] = ihct_counter_open(e, leader);
+        }
+    }
+    c->fds[IHCT_COUNTER_TASK_CLOCK] = ihct_counter_open(IHCT_COUNTER_TASK_CLOCK, -1);
+
+    bool any = false;
+    for(int e = 0; e < IHCT_COUNTER_COUNT; e++) {
+        if(c->fds[e] < 0) continue;
+        if(ioctl(c->fds[e], PERF_EVENT_IOC_ID, &c->ids[e]) != 0) c->ids[e] = 0;
+        any = true;
+    }
+    return any;
+}
+
+void ihct_counters_close(ihct_counters *c) {
+    for(int e = 0; e < IHCT_COUNTER_COUNT; e++) {
+        if(c->fds[e] >= 0) close(c->fds[e]);
+        c->fds[e] = -1;
+    }
+}
+
+// Applies an ioctl to the hardware group and the task clock.
+static void ihct_counters_ioctl(ihct_counters *c, unsigned long request) {
+    if(c->fds[IHCT_COUNTER_INSTRUCTIONS] >= 0) {
+        ioctl(c->fds[IHCT_COUNTER_INSTRUCTIONS], request, PERF_IOC_FLAG_GROUP);
+    }
+    if(c->fds[IHCT_COUNTER_TASK_CLOCK] >= 0) {
+        ioctl(c->fds[IHCT_COUNTER_TASK_CLOCK], request, 0);
+    }
+}
+
+void ihct_counters_start(ihct_counters *c) {
+    ihct_counters_ioctl(c, PERF_EVENT_IOC_RESET);
+    ihct_counters_ioctl(c, PERF_EVENT_IOC_ENABLE);
+}
+
+void ihct_counters_stop(ihct_counters *c) {
+    ihct_counters_ioctl(c, PERF_EVENT_IOC_DISABLE);
+}
+
+void ihct_counters_read(const ihct_counters *c, ihct_counter_values *v) {
+    memset(v, 0, sizeof(*v));
+
+    int groups[] = {c->fds[IHCT_COUNTER_INSTRUCTIONS], c->fds[IHCT_COUNTER_TASK_CLOCK]};
+    for(int g = 0; g < 2; g++) {
+        struct ihct_group_read data;
+        if(groups[g] < 0 || read(groups[g], &data, sizeof(data)) <= 0) continue;
+
+        // The PMU is shared; if the group only got part of the time, the counts
+        // are extrapolated to the whole of it.
+        double scale = 1;
+        if(data.time_running && data.time_running < data.time_enabled) {
+            scale = (double)data.time_enabled / data.time_running;
+        }
+        for(uint64_t k = 0; k < data.nr && k < IHCT_COUNTER_COUNT; k++) {
+            for(int e = 0; e < IHCT_COUNTER_COUNT; e++) {
+                if(c->fds[e] < 0 || c->ids[e] != data.values[k].id) continue;
+                v->values[e] = data.values[k].value * scale;
+                v->available |= 1u << e;
+            }
+        }
+    }
+}
+
+const char *ihct_counters_name(int event) {
+    return ihct_counter_events[event].name;
+}
@@ -0,0 +1,51 @@
+#ifndef IHCT_COUNTERS_H
+#define IHCT_COUNTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The counted events. The first four are hardware events, counted as one group;
+// task-clock is a software event, and is counted even without a PMU.
+enum {
+    IHCT_COUNTER_INSTRUCTIONS,
+    IHCT_COUNTER_CYCLES,
+    IHCT_COUNTER_CACHE_MISSES,
+    IHCT_COUNTER_BRANCH_MISSES,
+    IHCT_COUNTER_TASK_CLOCK,
+    IHCT_COUNTER_COUNT
+};
+
+// Perf event counters of a single thread. Events that couldn't be opened (not
+// supported, or not permitted) have an fd of -1.
+typedef struct {
+    int fds[IHCT_COUNTER_COUNT];
+    uint64_t ids[IHCT_COUNTER_COUNT];
+} ihct_counters;
+
+// Counted values, and a mask of which of them could be counted (1 << event).
+// Hardware events are scaled up when the PMU was multiplexed.
+typedef struct {
+    uint64_t values[IHCT_COUNTER_COUNT];
+    unsigned available;
+} ihct_counter_values;
+
+// Opens the counters of the calling thread, disabled. Returns false if none of
+// them could be opened.
+bool ihct_counters_open(ihct_counters *c);
+
+// Closes every opened counter.
+void ihct_counters_close(ihct_counters *c);
+
+// Zeroes and enables all counters.
+void ihct_counters_start(ihct_counters *c);
+
+// Disables all counters.
+void ihct_counters_stop(ihct_counters *c);
+
+// Reads the counts since the counters were started.
+void ihct_counters_read(const ihct_counters *c, ihct_counter_values *v);
+
+// Returns the name of an event, as used by perf.
+const char *ihct_counters_name(int event);
+
+#endif
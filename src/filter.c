@@ -0,0 +1,145 @@
+#include "filter.h"
+
+#include <fnmatch.h>
+#include <stdio.h>
+#include <string.h>
+
+bool ihct_filters_add(ihct_filters *f, const char *pattern, bool exclude) {
+    ihct_filter filter = {.exclude = exclude, .pattern = pattern};
+    if(!strncmp(pattern, "re:", 3)) {
+        filter.kind = IHCT_FILTER_REGEX;
+        if(regcomp(&filter.regex, pattern + 3, REG_EXTENDED | REG_NOSUB) != 0) return false;
+    } else if(pattern[0] == '@') {
+        filter.kind = IHCT_FILTER_TAG;
+    } else {
+        filter.kind = IHCT_FILTER_GLOB;
+        filter.prefix_len = strcspn(pattern, "*?[\\");
+    }
+
+    ihct_filter *filters = realloc(f->filters, (f->count + 1) * sizeof(*filters));
+    if(!filters) {
+        printf("Couldn't allocate memory for filters.\n");
+        exit(EXIT_FAILURE);
+    }
+    f->filters = filters;
+    f->filters[f->count++] = filter;
+    return true;
+}
+
+static bool ihct_filter_match(const ihct_filter *filter, const ihct_unit *unit) {
+    switch(filter->kind) {
+    case IHCT_FILTER_GLOB: return fnmatch(filter->pattern, unit->name, 0) == 0;
+    case IHCT_FILTER_REGEX: return regexec(&filter->regex, unit->name, 0, NULL, 0) == 0;
+    case IHCT_FILTER_TAG:
+        for(size_t i = 0; unit->tags && unit->tags[i]; i++) {
+            if(!strcmp(unit->tags[i], filter->pattern + 1)) return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+static int ihct_by_name_cmp(const void *a, const void *b) {
+    return strcmp((*(const ihct_unit *const *)a)->name, (*(const ihct_unit *const *)b)->name);
+}
+
+void ihct_filters_index(const ihct_unit *units, size_t count, const ihct_unit **by_name) {
+    for(size_t k = 0; k < count; k++) by_name[k] = &units[k];
+    qsort(by_name, count, sizeof(*by_name), ihct_by_name_cmp);
+}
+
+// Whether a unit is run as several, named after it ("name/3"), which are only
+// matched once it is expanded.
+static bool ihct_filter_expanded(const ihct_unit *unit) {
+    return unit->kind == IHCT_UNIT_PARAM || unit->kind == IHCT_UNIT_PROPERTY;
+}
+
+// Returns the first position in the index of a name starting with (or after)
+// the first n characters of prefix.
+static size_t ihct_index_lower_bound(const ihct_unit *const *by_name, size_t count,
+                                     const char *prefix, size_t n) {
+    size_t lo = 0, hi = count;
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(strncmp(by_name[mid]->name, prefix, n) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+bool ihct_filters_match(const ihct_filters *f, const ihct_unit *unit) {
+    bool includes = false, included = false;
+    for(size_t k = 0; k < f->count; k++) {
+        const ihct_filter *filter = &f->filters[k];
+        if(filter->exclude) {
+            if(ihct_filter_match(filter, unit)) return false;
+        } else {
+            includes = true;
+            if(!included) included = ihct_filter_match(filter, unit);
+        }
+    }
+    return !includes || included;
+}
+
+// Selects the units of the index named by a glob starting with a literal: those
+// whose names start with it, and those expanded into units it may name, if it
+// goes on past their name and a '/'.
+static void ihct_filter_select(const ihct_filter *filter, const ihct_unit *units,
+                               const ihct_unit *const *by_name, size_t count, bool *selected) {
+    const char *pattern = filter->pattern;
+    size_t n = filter->prefix_len;
+    for(size_t i = ihct_index_lower_bound(by_name, count, pattern, n);
+        i < count && !strncmp(by_name[i]->name, pattern, n); i++) {
+        const ihct_unit *u = by_name[i];
+        if(ihct_filter_expanded(u) || ihct_filter_match(filter, u)) selected[u - units] = true;
+    }
+    for(const char *slash = memchr(pattern, '/', n); slash;
+        slash = memchr(slash + 1, '/', n - (slash + 1 - pattern))) {
+        size_t len = slash - pattern;
+        for(size_t i = ihct_index_lower_bound(by_name, count, pattern, len);
+            i < count && !strncmp(by_name[i]->name, pattern, len) &&
+            by_name[i]->name[len] == '\0'; i++) {
+            if(ihct_filter_expanded(by_name[i])) selected[by_name[i] - units] = true;
+        }
+    }
+}
+
+void ihct_filters_select(const ihct_filters *f, const ihct_unit *units,
+                         const ihct_unit *const *by_name, size_t count, bool *selected) {
+    bool includes = false, all_prefixed = true;
+    for(size_t k = 0; k < f->count; k++) {
+        const ihct_filter *filter = &f->filters[k];
+        if(filter->exclude) continue;
+        includes = true;
+        if(filter->kind != IHCT_FILTER_GLOB || filter->prefix_len == 0) all_prefixed = false;
+    }
+
+    if(!includes || !all_prefixed) {
+        for(size_t k = 0; k < count; k++) {
+            selected[k] = ihct_filter_expanded(&units[k]) || ihct_filters_match(f, &units[k]);
+        }
+        return;
+    }
+
+    // Every include starts with a literal; only the range of names starting
+    // with it, found in the sorted index, has to be matched.
+    memset(selected, 0, count * sizeof(*selected));
+    for(size_t k = 0; k < f->count; k++) {
+        const ihct_filter *filter = &f->filters[k];
+        if(!filter->exclude) ihct_filter_select(filter, units, by_name, count, selected);
+    }
+    for(size_t k = 0; k < count; k++) {
+        if(selected[k] && !ihct_filter_expanded(&units[k])) {
+            selected[k] = ihct_filters_match(f, &units[k]);
+        }
+    }
+}
+
+void ihct_filters_free(ihct_filters *f) {
+    for(size_t k = 0; k < f->count; k++) {
+        if(f->filters[k].kind == IHCT_FILTER_REGEX) regfree(&f->filters[k].regex);
+    }
+    free(f->filters);
+    f->filters = NULL;
+    f->count = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef IHCT_FILTER_H
+#define IHCT_FILTER_H
+
+#include "ihct.h"
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// A pattern units are selected or excluded by. A pattern is a glob matched
+// against the unit name ("parse_*"), "re:" and an extended regular expression
+// searched for in the name, or "@" and a tag of the unit.
+typedef struct {
+    bool exclude;
+    enum {IHCT_FILTER_GLOB, IHCT_FILTER_REGEX, IHCT_FILTER_TAG} kind;
+    const char *pattern;
+    regex_t regex;
+    // Length of the literal start of a glob, all names matching it begin with.
+    size_t prefix_len;
+} ihct_filter;
+
+// Datatype representing the filters of a run. A unit is selected if it matches
+// any of the including filters (or there are none), and none of the excluding.
+// To be used internally in IHCT_RUN.
+typedef struct {
+    ihct_filter *filters;
+    size_t count;
+} ihct_filters;
+
+// Adds a filter. Returns false if the pattern is an invalid regular expression.
+bool ihct_filters_add(ihct_filters *f, const char *pattern, bool exclude);
+
+// Sorts the count units of a module by name into by_name, an index to select
+// them through. Built once, when the module is registered.
+void ihct_filters_index(const ihct_unit *units, size_t count, const ihct_unit **by_name);
+
+// Whether a unit is selected by the filters.
+bool ihct_filters_match(const ihct_filters *f, const ihct_unit *unit);
+
+// Marks which of the count units of a module are selected by the filters, in
+// selected. Globs starting with a literal are looked up in the index by_name,
+// and only look at the names starting with it. Parameterized tests and
+// properties are marked if any unit they are run as may be selected; those are
+// to be matched with ihct_filters_match once expanded.
+void ihct_filters_select(const ihct_filters *f, const ihct_unit *units,
+                         const ihct_unit *const *by_name, size_t count, bool *selected);
+
+// Deallocates the filters.
+void ihct_filters_free(ihct_filters *f);
+
+#endif
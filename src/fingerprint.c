@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+#include "fingerprint.h"
+
+#include <fcntl.h>
+#include <link.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// A defined symbol of a module, at an address relative to its load bias.
+typedef struct {
+    uintptr_t value;
+    size_t size;
+    char *name;
+} ihct_symbol;
+
+// The symbols of a loaded module (the executable, or a shared object), sorted
+// by address. Loaded once per module, on first use.
+typedef struct ihct_symbols {
+    uintptr_t bias;
+    char *path;
+    ihct_symbol *symbols;
+    size_t count;
+    struct ihct_symbols *next;
+} ihct_symbols;
+
+static ihct_symbols *modules;
+
+static uint64_t ihct_fnv1a(uint64_t h, const void *data, size_t n) {
+    const unsigned char *p = data;
+    for(size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int ihct_symbol_cmp(const void *a, const void *b) {
+    uintptr_t x = ((const ihct_symbol *)a)->value, y = ((const ihct_symbol *)b)->value;
+    return (x > y) - (x < y);
+}
+
+// Reads the symbol table of the ELF file at path, or the dynamic symbol table
+// if it has been stripped.
+static void ihct_read_symbols(ihct_symbols *m) {
+    int fd = open(m->path, O_RDONLY);
+    if(fd < 0) return;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ElfW(Ehdr))) {
+        close(fd);
+        return;
+    }
+    const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return;
+
+    const ElfW(Ehdr) *eh = (const ElfW(Ehdr) *)data;
+    size_t size = st.st_size;
+    if(memcmp(eh->e_ident, ELFMAG, SELFMAG) || eh->e_shoff == 0 ||
+       eh->e_shoff + (size_t)eh->e_shnum * sizeof(ElfW(Shdr)) > size) {
+        munmap((void *)data, size);
+        return;
+    }
+    const ElfW(Shdr) *sections = (const ElfW(Shdr) *)(data + eh->e_shoff);
+    const ElfW(Shdr) *symtab = NULL;
+    for(unsigned i = 0; i < eh->e_shnum; i++) {
+        if(sections[i].sh_type == SHT_SYMTAB) symtab = &sections[i];
+        else if(sections[i].sh_type == SHT_DYNSYM && !symtab) symtab = &sections[i];
+    }
+    if(!symtab || symtab->sh_link >= eh->e_shnum ||
+       symtab->sh_offset + symtab->sh_size > size) {
+        munmap((void *)data, size);
+        return;
+    }
+    const ElfW(Shdr) *strtab = &sections[symtab->sh_link];
+    if(strtab->sh_offset + strtab->sh_size > size) {
+        munmap((void *)data, size);
+        return;
+    }
+
+    const ElfW(Sym) *syms = (const ElfW(Sym) *)(data + symtab->sh_offset);
+    size_t n = symtab->sh_size / sizeof(ElfW(Sym));
+    m->symbols = malloc((n ? n : 1) * sizeof(*m->symbols));
+    for(size_t i = 0; m->symbols && i < n; i++) {
+        int type = ELF64_ST_TYPE(syms[i].st_info);
+        if(syms[i].st_shndx == SHN_UNDEF || syms[i].st_size == 0 ||
+           (type != STT_FUNC && type != STT_OBJECT) || syms[i].st_name >= strtab->sh_size) {
+            continue;
+        }
+        m->symbols[m->count++] = (ihct_symbol){syms[i].st_value, syms[i].st_size,
+            strdup(data + strtab->sh_offset + syms[i].st_name)};
+    }
+    munmap((void *)data, size);
+    qsort(m->symbols, m->count, sizeof(*m->symbols), ihct_symbol_cmp);
+}
+
+// The module an address is in, found while iterating over the loaded modules.
+struct ihct_module_search {
+    uintptr_t addr;
+    uintptr_t bias;
+    const char *name;
+    bool found;
+};
+
+static int ihct_find_module_proc(struct dl_phdr_info *info, size_t size, void *arg) {
+    (void)size;
+    struct ihct_module_search *s = arg;
+    for(unsigned i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+        uintptr_t begin = info->dlpi_addr + ph->p_vaddr;
+        if(ph->p_type == PT_LOAD && s->addr >= begin && s->addr < begin + ph->p_memsz) {
+            s->bias = info->dlpi_addr;
+            s->name = info->dlpi_name;
+            s->found = true;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Returns the symbols of the module containing addr.
+static ihct_symbols *ihct_module_of(const void *addr) {
+    struct ihct_module_search s = {(uintptr_t)addr, 0, NULL, false};
+    dl_iterate_phdr(&ihct_find_module_proc, &s);
+    if(!s.found) return NULL;
+
+    for(ihct_symbols *m = modules; m; m = m->next) {
+        if(m->bias == s.bias) return m;
+    }
+    ihct_symbols *m = calloc(1, sizeof(*m));
+    if(!m) return NULL;
+    m->bias = s.bias;
+    // The executable itself has no name.
+    m->path = strdup(s.name && *s.name ? s.name : "/proc/self/exe");
+    ihct_read_symbols(m);
+    m->next = modules;
+    modules = m;
+    return m;
+}
+
+static const ihct_symbol *ihct_symbol_at(const ihct_symbols *m, uintptr_t value) {
+    ihct_symbol key = {value, 0, NULL};
+    return m->count ? bsearch(&key, m->symbols, m->count, sizeof(*m->symbols),
+                              ihct_symbol_cmp) : NULL;
+}
+
+static const ihct_symbol *ihct_symbol_named(const ihct_symbols *m, const char *name) {
+    for(size_t i = 0; i < m->count; i++) {
+        if(!strcmp(m->symbols[i].name, name)) return &m->symbols[i];
+    }
+    return NULL;
+}
+
+static uint64_t ihct_hash_file(uint64_t h, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if(!f) return h;
+    char buf[4096];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0) h = ihct_fnv1a(h, buf, n);
+    fclose(f);
+    return h;
+}
+
+bool ihct_fingerprint_unit(const void *proc, const char *const *deps, uint64_t *fingerprint) {
+    ihct_symbols *m = ihct_module_of(proc);
+    if(!m) return false;
+    const ihct_symbol *sym = ihct_symbol_at(m, (uintptr_t)proc - m->bias);
+    if(!sym) return false;
+
+    uint64_t h = ihct_fnv1a(14695981039346656037ULL, proc, sym->size);
+    for(size_t i = 0; deps && deps[i]; i++) {
+        // Names are hashed as well, so that adding a dependency counts as a change.
+        h = ihct_fnv1a(h, deps[i], strlen(deps[i]) + 1);
+        if(!strncmp(deps[i], "sym:", 4)) {
+            const ihct_symbol *dep = ihct_symbol_named(m, deps[i] + 4);
+            if(!dep) return false;
+            h = ihct_fnv1a(h, (const void *)(m->bias + dep->value), dep->size);
+        } else {
+            h = ihct_hash_file(h, deps[i]);
+        }
+    }
+    // Zero is reserved for removals from the cache.
+    *fingerprint = h ? h : 1;
+    return true;
+}
+
+void ihct_fingerprint_data(uint64_t *fingerprint, const void *data, size_t size) {
+    uint64_t h = ihct_fnv1a(*fingerprint, data, size);
+    *fingerprint = h ? h : 1;
+}
+
+void ihct_fingerprint_free(void) {
+    while(modules) {
+        ihct_symbols *m = modules;
+        modules = m->next;
+        for(size_t i = 0; i < m->count; i++) free(m->symbols[i].name);
+        free(m->symbols);
+        free(m->path);
+        free(m);
+    }
+}
+
+// A cache is a text file with one line per unit: the hash of its name, and its
+// fingerprint, both in hexadecimal.
+
+static int ihct_cache_cmp(const void *a, const void *b) {
+    uint64_t x = ((const ihct_cache_entry *)a)->name_hash;
+    uint64_t y = ((const ihct_cache_entry *)b)->name_hash;
+    return (x > y) - (x < y);
+}
+
+bool ihct_cache_load(ihct_cache *c, const char *path) {
+    c->entries = NULL;
+    c->count = 0;
+
+    FILE *f = fopen(path, "r");
+    if(!f) return access(path, F_OK) != 0;
+
+    size_t cap = 0;
+    unsigned long long name_hash, fingerprint;
+    while(fscanf(f, "%llx %llx", &name_hash, &fingerprint) == 2) {
+        if(c->count == cap) {
+            cap = cap ? cap * 2 : 64;
+            c->entries = realloc(c->entries, cap * sizeof(*c->entries));
+        }
+        c->entries[c->count++] = (ihct_cache_entry){name_hash, fingerprint};
+    }
+    fclose(f);
+    qsort(c->entries, c->count, sizeof(*c->entries), ihct_cache_cmp);
+    return true;
+}
+
+bool ihct_cache_get(const ihct_cache *c, uint64_t name_hash, uint64_t *fingerprint) {
+    ihct_cache_entry key = {name_hash, 0};
+    const ihct_cache_entry *e = c->count ?
+        bsearch(&key, c->entries, c->count, sizeof(*c->entries), ihct_cache_cmp) : NULL;
+    if(!e) return false;
+    *fingerprint = e->fingerprint;
+    return true;
+}
+
+// An update, and its position among the updates.
+typedef struct {
+    ihct_cache_entry entry;
+    size_t index;
+} ihct_cache_update_item;
+
+static int ihct_cache_update_cmp(const void *a, const void *b) {
+    const ihct_cache_update_item *x = a, *y = b;
+    int c = ihct_cache_cmp(&x->entry, &y->entry);
+    if(c) return c;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+void ihct_cache_update(ihct_cache *c, const ihct_cache_entry *updates, size_t n) {
+    ihct_cache_update_item *items = malloc((n ? n : 1) * sizeof(*items));
+    ihct_cache_entry *merged = malloc((c->count + n ? c->count + n : 1) * sizeof(*merged));
+    if(!items || !merged) {
+        printf("Couldn't allocate memory for cache.\n");
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < n; i++) items[i] = (ihct_cache_update_item){updates[i], i};
+    qsort(items, n, sizeof(*items), ihct_cache_update_cmp);
+
+    // Merge the sorted updates into the entries. Of equal hashes, the entry
+    // comes first and the last update last, and only the last is kept.
+    size_t count = 0;
+    for(size_t i = 0, j = 0; i < c->count || j < n;) {
+        ihct_cache_entry e;
+        if(j == n || (i < c->count && c->entries[i].name_hash <= items[j].entry.name_hash)) {
+            e = c->entries[i++];
+        } else {
+            e = items[j++].entry;
+        }
+        if(count && merged[count - 1].name_hash == e.name_hash) count--;
+        merged[count++] = e;
+    }
+    free(items);
+
+    // Drop the removed units.
+    size_t kept = 0;
+    for(size_t i = 0; i < count; i++) {
+        if(merged[i].fingerprint) merged[kept++] = merged[i];
+    }
+    free(c->entries);
+    c->entries = merged;
+    c->count = kept;
+}
+
+bool ihct_cache_save(const ihct_cache *c, const char *path) {
+    FILE *f = fopen(path, "w");
+    if(!f) return false;
+    for(size_t i = 0; i < c->count; i++) {
+        fprintf(f, "%016llx %016llx\n", (unsigned long long)c->entries[i].name_hash,
+                (unsigned long long)c->entries[i].fingerprint);
+    }
+    return fclose(f) == 0;
+}
+
+void ihct_cache_free(ihct_cache *c) {
+    free(c->entries);
+    c->entries = NULL;
+    c->count = 0;
+}
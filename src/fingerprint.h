@@ -0,0 +1,53 @@
+#ifndef IHCT_FINGERPRINT_H
+#define IHCT_FINGERPRINT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Computes the fingerprint of a unit: a hash of the machine code of its
+// procedure, and of its dependencies. A dependency is the name of a file, whose
+// contents are hashed, or "sym:" and the name of a function (or object) in the
+// same module, whose code is hashed. The code of a symbol is found through the
+// symbol table of its module. Returns false if the procedure, or one of the
+// symbols, can't be found (for instance, in a stripped binary). A missing file
+// hashes as empty.
+bool ihct_fingerprint_unit(const void *proc, const char *const *deps, uint64_t *fingerprint);
+
+// Adds data, such as the row of a parameterized test, to a fingerprint.
+void ihct_fingerprint_data(uint64_t *fingerprint, const void *data, size_t size);
+
+// Frees the symbol tables loaded while computing fingerprints.
+void ihct_fingerprint_free(void);
+
+// The fingerprints of units that last passed, by the hash of their name.
+typedef struct {
+    uint64_t name_hash;
+    uint64_t fingerprint;
+} ihct_cache_entry;
+
+// Datatype representing a cache of fingerprints, sorted by name hash. To be
+// used internally in IHCT_RUN.
+typedef struct {
+    ihct_cache_entry *entries;
+    size_t count;
+} ihct_cache;
+
+// Loads the cache in the file at path. A missing file is an empty cache.
+// Returns false if the file couldn't be read.
+bool ihct_cache_load(ihct_cache *c, const char *path);
+
+// Gets the fingerprint of a unit. Returns false if it isn't in the cache.
+bool ihct_cache_get(const ihct_cache *c, uint64_t name_hash, uint64_t *fingerprint);
+
+// Applies n updates to the cache. An update with a fingerprint of 0 removes the
+// unit; later updates of the same unit take precedence.
+void ihct_cache_update(ihct_cache *c, const ihct_cache_entry *updates, size_t n);
+
+// Saves the cache to the file at path. Returns false if it couldn't be written.
+bool ihct_cache_save(const ihct_cache *c, const char *path);
+
+// Deallocates the cache.
+void ihct_cache_free(ihct_cache *c);
+
+#endif
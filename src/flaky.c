@@ -0,0 +1,65 @@
+#include "flaky.h"
+
+#include <math.h>
+#include <string.h>
+
+static bool ihct_flaky_same(const ihct_flaky_location *l, const ihct_test_result *result) {
+    if(l->status != (int)result->status || l->line != result->line) return false;
+    if(!l->file != !result->file || (l->file && strcmp(l->file, result->file))) return false;
+    return !l->code == !result->code && (!l->code || !strcmp(l->code, result->code));
+}
+
+void ihct_flaky_add(ihct_flaky *f, const ihct_test_result *result, double wall) {
+    if(f->runs == 0 || wall < f->wall_min) f->wall_min = wall;
+    if(f->runs == 0 || wall > f->wall_max) f->wall_max = wall;
+    f->runs++;
+    int b = wall > 1e-6 ? (int)(4 * log2(wall * 1e6)) : 0;
+    f->buckets[b < IHCT_FLAKY_BUCKETS ? b : IHCT_FLAKY_BUCKETS - 1]++;
+    if(result->status == PASS) return;
+
+    f->failures++;
+    for(unsigned k = 0; k < f->location_count; k++) {
+        if(ihct_flaky_same(&f->locations[k], result)) {
+            f->locations[k].count++;
+            return;
+        }
+    }
+    if(f->location_count == IHCT_FLAKY_LOCATIONS) {
+        f->other_failures++;
+        return;
+    }
+    // The result is cleared after, so what it points at is copied.
+    ihct_flaky_location *l = &f->locations[f->location_count++];
+    l->status = result->status;
+    l->file = result->file ? strdup(result->file) : NULL;
+    l->line = result->line;
+    l->code = result->code ? strdup(result->code) : NULL;
+    l->count = 1;
+}
+
+bool ihct_flaky_is_flaky(const ihct_flaky *f) {
+    return f->failures > 0 && f->failures < f->runs;
+}
+
+double ihct_flaky_quantile(const ihct_flaky *f, double q) {
+    if(!f->runs) return 0;
+    unsigned rank = q * (f->runs - 1), seen = 0;
+    int b = 0;
+    for(; b < IHCT_FLAKY_BUCKETS - 1; b++) {
+        seen += f->buckets[b];
+        if(seen > rank) break;
+    }
+    // The middle of the bucket, within what was actually seen.
+    double v = 1e-6 * exp2((b + 0.5) / 4);
+    if(v < f->wall_min) v = f->wall_min;
+    if(v > f->wall_max) v = f->wall_max;
+    return v;
+}
+
+void ihct_flaky_free(ihct_flaky *f) {
+    for(unsigned k = 0; k < f->location_count; k++) {
+        free(f->locations[k].file);
+        free(f->locations[k].code);
+    }
+    f->location_count = 0;
+}
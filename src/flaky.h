@@ -0,0 +1,49 @@
+#ifndef IHCT_FLAKY_H
+#define IHCT_FLAKY_H
+
+#include "ihct.h"
+
+#include <stdint.h>
+
+// Most distinct ways a unit failing over and over is told apart by.
+#define IHCT_FLAKY_LOCATIONS 4
+
+// Buckets of the durations of a unit, four per doubling, from a microsecond.
+// The last one holds everything longer than about 16 seconds.
+#define IHCT_FLAKY_BUCKETS 96
+
+// A way a unit failed: where, or how, and how many times.
+typedef struct {
+    int status;
+    char *file;
+    unsigned long line;
+    char *code;
+    unsigned count;
+} ihct_flaky_location;
+
+// What every run of a unit, run over and over, came to.
+typedef struct {
+    unsigned runs;
+    unsigned failures;
+    ihct_flaky_location locations[IHCT_FLAKY_LOCATIONS];
+    unsigned location_count;
+    // Failures that didn't fit among the locations.
+    unsigned other_failures;
+    double wall_min, wall_max;
+    uint32_t buckets[IHCT_FLAKY_BUCKETS];
+} ihct_flaky;
+
+// Adds a run of a unit, taking the given wall time in seconds.
+void ihct_flaky_add(ihct_flaky *f, const ihct_test_result *result, double wall);
+
+// Whether a unit both passed and failed, so doesn't only depend on its code.
+bool ihct_flaky_is_flaky(const ihct_flaky *f);
+
+// Returns about the q quantile of the durations of a unit, in seconds; exact to
+// within a fifth.
+double ihct_flaky_quantile(const ihct_flaky *f, double q);
+
+// Frees what the locations of a unit hold.
+void ihct_flaky_free(ihct_flaky *f);
+
+#endif
@@ -0,0 +1,166 @@
+#include "history.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// A history file starts with a magic string, followed by nothing but records.
+// It is only ever appended to; records of a run are written with one write to
+// a file opened with O_APPEND, so concurrent runs don't interleave records.
+static const char ihct_history_magic[8] = "IHCTHST1";
+
+uint64_t ihct_history_hash(const char *name) {
+    uint64_t h = 14695981039346656037ULL;
+    for(; *name; name++) {
+        h ^= (unsigned char)*name;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int ihct_history_cmp(const void *a, const void *b) {
+    uint64_t x = ((const ihct_history_unit *)a)->name_hash;
+    uint64_t y = ((const ihct_history_unit *)b)->name_hash;
+    return (x > y) - (x < y);
+}
+
+// A record, and the number of the run it belongs to.
+typedef struct {
+    ihct_history_record record;
+    unsigned run;
+} ihct_history_entry;
+
+// Orders entries by unit, and then by run.
+static int ihct_history_entry_cmp(const void *a, const void *b) {
+    const ihct_history_entry *x = a, *y = b;
+    if(x->record.name_hash != y->record.name_hash) {
+        return (x->record.name_hash > y->record.name_hash) -
+               (x->record.name_hash < y->record.name_hash);
+    }
+    return (x->run > y->run) - (x->run < y->run);
+}
+
+bool ihct_history_load(ihct_history *h, const char *path) {
+    h->units = NULL;
+    h->count = 0;
+    h->run_count = 0;
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return errno == ENOENT;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if(st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+    const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return false;
+    if((size_t)st.st_size < sizeof(ihct_history_magic) ||
+       memcmp(data, ihct_history_magic, sizeof(ihct_history_magic))) {
+        munmap((void *)data, st.st_size);
+        return false;
+    }
+
+    // Runs are numbered in file order, and the records then grouped by unit. A
+    // partially written record at the end is ignored.
+    size_t n = (st.st_size - sizeof(ihct_history_magic)) / sizeof(ihct_history_record);
+    ihct_history_entry *entries = malloc((n ? n : 1) * sizeof(*entries));
+    if(!entries) {
+        munmap((void *)data, st.st_size);
+        return false;
+    }
+    const char *records = data + sizeof(ihct_history_magic);
+    for(size_t i = 0; i < n; i++) {
+        memcpy(&entries[i].record, records + i * sizeof(ihct_history_record),
+               sizeof(ihct_history_record));
+        if(i == 0 || entries[i].record.run != entries[i - 1].record.run) h->run_count++;
+        entries[i].run = h->run_count;
+    }
+    munmap((void *)data, st.st_size);
+    qsort(entries, n, sizeof(*entries), ihct_history_entry_cmp);
+
+    h->units = malloc((n ? n : 1) * sizeof(*h->units));
+    if(!h->units) {
+        free(entries);
+        h->run_count = 0;
+        return false;
+    }
+    for(size_t i = 0; i < n; i++) {
+        const ihct_history_record *r = &entries[i].record;
+        if(i == 0 || r->name_hash != entries[i - 1].record.name_hash) {
+            h->units[h->count++] = (ihct_history_unit){.name_hash = r->name_hash};
+        }
+        ihct_history_unit *u = &h->units[h->count - 1];
+
+        u->runs++;
+        u->last_status = r->status;
+        if(r->status) {
+            u->failures++;
+            u->failed = entries[i].run;
+        }
+        if(u->wall_count == IHCT_HISTORY_WINDOW) {
+            memmove(u->walls, u->walls + 1, (IHCT_HISTORY_WINDOW - 1) * sizeof(double));
+            u->wall_count--;
+        }
+        u->walls[u->wall_count++] = r->wall;
+    }
+    free(entries);
+    return true;
+}
+
+const ihct_history_unit *ihct_history_find(const ihct_history *h, uint64_t name_hash) {
+    if(!h->count) return NULL;
+    ihct_history_unit key = {.name_hash = name_hash};
+    return bsearch(&key, h->units, h->count, sizeof(*h->units), ihct_history_cmp);
+}
+
+double ihct_history_mean_wall(const ihct_history_unit *u) {
+    if(!u->wall_count) return 0;
+    double sum = 0;
+    for(unsigned i = 0; i < u->wall_count; i++) sum += u->walls[i];
+    return sum / u->wall_count;
+}
+
+bool ihct_history_append(const char *path, const ihct_history_record *records, size_t n) {
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if(fd < 0) return false;
+
+    struct stat st;
+    size_t header = fstat(fd, &st) == 0 && st.st_size == 0 ? sizeof(ihct_history_magic) : 0;
+    size_t len = header + n * sizeof(*records);
+    char *buf = malloc(len ? len : 1);
+    if(!buf) {
+        close(fd);
+        return false;
+    }
+    memcpy(buf, ihct_history_magic, header);
+    memcpy(buf + header, records, n * sizeof(*records));
+
+    bool ok = true;
+    for(size_t done = 0; done < len;) {
+        ssize_t w = write(fd, buf + done, len - done);
+        if(w < 0 && errno == EINTR) continue;
+        if(w <= 0) {
+            ok = false;
+            break;
+        }
+        done += w;
+    }
+    free(buf);
+    return close(fd) == 0 && ok;
+}
+
+void ihct_history_free(ihct_history *h) {
+    free(h->units);
+    h->units = NULL;
+    h->count = 0;
+    h->run_count = 0;
+}
@@ -0,0 +1,63 @@
+#ifndef IHCT_HISTORY_H
+#define IHCT_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Number of recent runs of a unit kept track of when loading a history.
+#define IHCT_HISTORY_WINDOW 8
+
+// The result of a unit in one run, as stored in a history file. All records of
+// a run are appended at once, and share its run id.
+typedef struct {
+    uint64_t run;
+    uint64_t name_hash;
+    double wall;
+    uint32_t status;
+    uint32_t reserved;
+} ihct_history_record;
+
+// What a history tells about a unit. Runs are numbered from 1, in the order
+// they were appended; failed is the number of the last run the unit failed in,
+// or 0 if it never did. walls holds the durations of its wall_count most
+// recent runs, oldest first.
+typedef struct {
+    uint64_t name_hash;
+    unsigned runs;
+    unsigned failures;
+    unsigned failed;
+    uint32_t last_status;
+    unsigned wall_count;
+    double walls[IHCT_HISTORY_WINDOW];
+} ihct_history_unit;
+
+// Datatype representing the results of past runs, by unit. To be used
+// internally in IHCT_RUN.
+typedef struct {
+    ihct_history_unit *units;
+    size_t count;
+    unsigned run_count;
+} ihct_history;
+
+// Returns the 64-bit FNV-1a hash of a unit name, identifying it in a history.
+uint64_t ihct_history_hash(const char *name);
+
+// Loads the history in the file at path. A missing file is an empty history.
+// Returns false if the file couldn't be read, or isn't a history.
+bool ihct_history_load(ihct_history *h, const char *path);
+
+// Finds the unit with the given name hash, or NULL if it has no history.
+const ihct_history_unit *ihct_history_find(const ihct_history *h, uint64_t name_hash);
+
+// Returns the mean of the recent durations of a unit.
+double ihct_history_mean_wall(const ihct_history_unit *u);
+
+// Appends the records of a run to the file at path, creating it if needed.
+// Returns false if it couldn't be written.
+bool ihct_history_append(const char *path, const ihct_history_record *records, size_t n);
+
+// Deallocates the history.
+void ihct_history_free(ihct_history *h);
+
+#endif
@@ -1,41 +1,308 @@
+// RUSAGE_THREAD is Linux specific.
+#define _GNU_SOURCE
 #include "ihct.h"
 #include "vector.h"
+#include "strbuf.h"
+#include "stats.h"
+#include "baseline.h"
+#include "counters.h"
+#include "alloc.h"
+#include "history.h"
+#include "fingerprint.h"
+#include "filter.h"
+#include "property.h"
+#include "reporter.h"
+#include "memdiff.h"
+#include "flaky.h"
+#include "concurrent.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
 #include <time.h>
 #include <setjmp.h>
 #include <signal.h> // handle tests that yield fatal signals.
 #include <errno.h>
 #include <pthread.h>
 #include <unistd.h>
-
-// The point of which to restore to on a fatal signal.
-jmp_buf restore_environment;
+#include <getopt.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// The point of which to restore to on a fatal signal. Every thread running a
+// unit has its own, since a jump buffer can't be shared across threads. The
+// signal mask is saved along with it, so the thread can be reused after a jump.
+static __thread sigjmp_buf restore_environment;
+// Set while restore_environment is valid to jump to.
+static __thread bool restore_armed;
 // the sigaction used for catching fatal signals.
 struct sigaction recover_action;
-// The final summary string printed.
-char *summary_str;
-// A list of all units.
+// The final summary printed, and the pending part of the progress line. Only
+// ever touched by the thread collecting results, which does so in unit order.
+static ihct_strbuf summary;
+static ihct_strbuf progress;
+// When the progress line was last written out (on CLOCK_MONOTONIC), and how
+// often it is, in nanoseconds.
+static struct timespec progress_flushed;
+#define IHCT_PROGRESS_INTERVAL 100000000L
+// A list of all modules with a unit section.
+static ihct_module_units *module_units;
+// A list of units registered without a section (see IHCT_NO_SECTIONS), or
+// created at runtime.
 static ihct_vector *testunits;
-// An array of all first failed (or last if all successful) assert results in every test.
-static ihct_test_result **ihct_results;
-
-// Object representing a testing unit, containing the units name and its procedure
-// (implemented test function).
+// All units of the current run, gathered from every module and the list above.
+static const ihct_unit **units;
+static unsigned unit_count;
+// The number of units run in the current round. A round runs the unit list a
+// number of times over: unit i is run in slots i, unit_count + i and so on.
+static unsigned slot_count;
+// Least number of units run in a round, when units are run over and over.
+#define IHCT_ROUND_SLOTS 256
+
+// Results of a benchmark. Times are in nanoseconds per iteration.
 typedef struct {
-    char *name;
-    ihct_test_proc procedure;
-} ihct_unit;
-
-
-// The number of seconds passed until a test is considered timedout.
-// Default 3. Can be set with -t [time in sec]
-int test_timeout = 3;
+    size_t iterations;
+    size_t bytes;
+    double median;
+    double min;
+    double mad;
+    unsigned sample_count;
+    double *samples;
+    // Set when compared to a baseline: the baseline median, and the p-value of
+    // the samples being as different as they are.
+    bool compared;
+    double baseline_median;
+    double p;
+} ihct_bench_stats;
+
+// Resources used by a unit while it ran. Times are in seconds, and counters are
+// those of the thread running the unit. The peak resident set size is that of
+// the whole process (the child, when isolated), in kilobytes.
+typedef struct {
+    double wall;
+    double cpu;
+    long minflt;
+    long majflt;
+    long nvcsw;
+    long nivcsw;
+    long maxrss;
+    // Perf event counts, with --counters.
+    ihct_counter_values counters;
+    // Heap allocations of a test, when tracked.
+    ihct_alloc_stats allocs;
+} ihct_unit_stats;
+
+// Everything recorded for a unit that has run: its first failed (or last if all
+// successful) assert result, and its measurements.
+typedef struct {
+    ihct_test_result result;
+    ihct_unit_stats stats;
+    ihct_bench_stats *bench;
+    ihct_concurrent_stats *concurrent;
+    // Set for a unit not run, since it passed before and hasn't changed.
+    bool cached;
+    // Set for a unit taken in a batch, but not run since the deadline passed.
+    bool skipped;
+} ihct_record;
+
+// An array of the records of every unit.
+static ihct_record **records;
+// Resources used by every unit, and its status, kept after their records are
+// freed. Units not started because of --max-failures didn't run.
+static ihct_unit_stats *unit_stats;
+static unsigned *unit_status;
+static bool *unit_ran;
+// With --incremental, the fingerprint of every unit (0 if it has none), and
+// whether it is unchanged since it last passed.
+static uint64_t *unit_fingerprints;
+static bool *unit_cached;
+// The time limit of every unit, in milliseconds, or 0 for none.
+static long *unit_timeouts;
+
+// The number of milliseconds passed until a test is considered timed out, or 0
+// for no limit. Default 3 seconds. Can be set with -t [duration], and for a
+// single unit with IHCT_TEST_TIMEOUT
+long test_timeout;
+// Time the whole run may take, in milliseconds, or 0 for no limit. Units still
+// running then time out, and the rest aren't run. Set with --deadline
+long suite_timeout;
+// The number of workers running units concurrently. Defaults to the number of
+// online cpus. Can be set with -j [workers]
+long test_jobs;
+// Whether units are run in separate processes. Set with --isolate
+bool test_isolate;
+// Number of slowest units to list after a run. Set with --slowest
+long test_slowest;
+// Whether units are counted with perf events. Set with --counters
+bool test_counters;
+// Whether benchmarks are run instead of tests. Set with -b (--bench)
+bool test_bench;
+// Minimum time of a single benchmark sample in milliseconds, and the number of
+// samples taken. Can be set with --bench-time and --bench-samples
+long bench_time;
+long bench_samples;
+// Number of samples run and thrown away before measuring.
+#define IHCT_BENCH_WARMUP 2
+// Files benchmark samples are saved to and compared against. Set with
+// --save-baseline and --compare-baseline
+char *bench_save_path;
+char *bench_compare_path;
+// How many percent slower than the baseline a benchmark may get before failing.
+// Can be set with --regression-threshold
+double bench_threshold;
+// Significance level a slowdown has to reach to be considered a regression.
+#define IHCT_REGRESSION_ALPHA 0.01
+// The shard run (counted from 1) and the number of shards. Set with --shard i/N
+long shard_index;
+long shard_count;
+// Files unit durations are packed into shards by, and saved to. Set with
+// --timings and --save-timings
+char *timings_path;
+char *timings_save_path;
+// File the results of every run are appended to, and units are ordered by.
+// Set with --history
+char *history_path;
+static ihct_history history;
+// Whether to print what the history tells about every unit, instead of running
+// them. Set with --history-report
+bool history_report;
+// Patterns units are selected and excluded by. Set with -f (--filter) and
+// --exclude; a filter starting with '!' excludes as well.
+static ihct_filters filters;
+// Whether to list the selected units, instead of running them. Set with --list
+bool test_list;
+// Whether units that passed are skipped until they change, and the file their
+// fingerprints are cached in. Set with --incremental and --cache. --no-cache
+// runs every unit, but still updates the cache.
+bool test_incremental;
+bool cache_ignored;
+char *cache_path;
+// Keys units are ordered by before running, most significant first. Units
+// otherwise run in the order they are defined. Set with --order
+enum {IHCT_ORDER_FAILED_FIRST, IHCT_ORDER_FASTEST_FIRST};
+#define IHCT_ORDER_MAX_KEYS 4
+static int order_keys[IHCT_ORDER_MAX_KEYS];
+static int order_key_count;
+// Number of failed units after which no more units are started, or 0 to run
+// them all. Set with --max-failures, or --fail-fast for 1
+long max_failures;
+// The number of times every unit is run, or 0 to keep going until a unit fails.
+// Set with --repeat and --until-fail; --flaky-report shows how every unit did
+// over all of its runs.
+long test_repeat;
+bool until_fail;
+bool flaky_report;
+static ihct_flaky *unit_flaky;
+// The number of cases every property is checked for, and the seed they are
+// drawn from. Set with --cases and --seed; the seed is random by default.
+long property_cases;
+static uint64_t property_seed;
+static bool property_seed_set;
+// Reporter results are streamed to as units get done, and the file it writes
+// to, or NULL for stdout. Set with --reporter and --output. Reporting to stdout
+// replaces the text output.
+static const ihct_reporter *reporter;
+char *report_path;
+static FILE *report_out;
+static bool text_output;
+static ihct_baseline baseline;
+// Bytes processed per iteration by the running benchmark.
+static __thread size_t bench_bytes;
+
+// Sets every option to its default. Done before parsing the arguments of every
+// run, so that options of an earlier run don't carry over.
+static void ihct_default_options(void) {
+    test_timeout = 3000;
+    suite_timeout = 0;
+    test_jobs = 0;
+    test_isolate = false;
+    test_slowest = 0;
+    test_counters = false;
+    test_bench = false;
+    bench_time = 10;
+    bench_samples = 30;
+    bench_save_path = NULL;
+    bench_compare_path = NULL;
+    bench_threshold = 5;
+    shard_index = 0;
+    shard_count = 0;
+    timings_path = NULL;
+    timings_save_path = NULL;
+    history_path = NULL;
+    history_report = false;
+    test_list = false;
+    test_incremental = false;
+    cache_ignored = false;
+    cache_path = ".ihct_cache";
+    order_key_count = 0;
+    max_failures = 0;
+    test_repeat = 1;
+    until_fail = false;
+    flaky_report = false;
+    property_cases = 1000;
+    property_seed_set = false;
+    reporter = NULL;
+    report_path = NULL;
+    text_output = true;
+}
 
-pthread_cond_t routine_done = PTHREAD_COND_INITIALIZER;
-pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+// A worker is a long-lived executor that pulls units from the shared unit list
+// and runs them one at a time. The watchdog inspects every worker to enforce
+// the timeout, and replaces the thread of a worker whose unit has hung.
+typedef struct {
+    pthread_t tid;
+    pthread_mutex_t lock;
+    // Bumped every time the worker gets a new thread. A thread that finds it
+    // no longer matches its own generation has been given up on, and exits.
+    unsigned generation;
+    // Whether a unit is running, which one, when it started and, if timed, when it
+    // has to be done. Times are on CLOCK_MONOTONIC.
+    bool running;
+    unsigned current;
+    // End of the batch of units the worker has taken, of which current is one.
+    unsigned batch_end;
+    struct timespec started;
+    bool timed;
+    struct timespec deadline;
+    // The child process running units for this worker when isolated, and the
+    // socket to it. Killed is set by the watchdog when it kills a hung child.
+    pid_t child;
+    int child_fd;
+    bool killed;
+} ihct_worker;
+
+static ihct_worker *workers;
+// Index of the next unit to be picked up by a worker. Workers take the rows of
+// a parameterized test in batches; a batch starting at unit i has unit_batches[i]
+// units, and next_unit only ever points to the start of a batch.
+static unsigned next_unit;
+static unsigned *unit_batches;
+// Set once max_failures units have failed, after which no more units are
+// picked up; only the first scheduled_count units were. Guarded by result_lock.
+static bool scheduling_stopped;
+static unsigned scheduled_count;
+static unsigned published_failures;
+// When the whole run has to be done, with a suite timeout, and whether that
+// stopped it.
+static struct timespec suite_deadline;
+static bool suite_deadline_reached;
+// Signaled whenever a worker has stored a result, so the collecting thread can
+// report results in unit order. Waits on it are timed on CLOCK_MONOTONIC.
+static pthread_cond_t result_ready;
+static pthread_mutex_t result_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// The watchdog sleeps until the earliest deadline of any running unit. Workers
+// wake it when starting a unit that has to be done before that. Waits on it are
+// timed on CLOCK_MONOTONIC, so they aren't disturbed by changes to the clock.
+static pthread_t watchdog_tid;
+static pthread_cond_t watchdog_wake;
+static pthread_mutex_t watchdog_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec watchdog_next;
+static bool watchdog_sleeping, watchdog_has_next, watchdog_stop;
 
 // These are ISO/IEC 6429 escape sequences for
 // communicating text attributes to terminal emulators.
@@ -63,8 +330,14 @@ pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
 // Procedure called when a signal is thrown within a test. When a fatal signal is
 // recieved, we jump back to before the test is ran, giving the signal code.
 static void ihct_recovery_proc(int sig) {
+    // A signal outside of a unit is not ours to handle; let it be fatal.
+    if(!restore_armed) {
+        signal(sig, SIG_DFL);
+        raise(sig);
+        return;
+    }
     // Restore.
-    longjmp(restore_environment, sig);
+    siglongjmp(restore_environment, sig);
 }
 
 // Binds the sigaction to signals, and make it call ihct_recovery_proc.
@@ -73,7 +346,7 @@ static void ihct_setup_recover_action(void) {
     sigemptyset(&recover_action.sa_mask);
     recover_action.sa_flags = 0;
     // binding sigactions. Dont pick up on user interrupts (let them be managed
-    // normally).
+    // normally). Since handlers are process-wide, this is done once per run.
     sigaction(SIGSEGV, &recover_action, NULL);
     sigaction(SIGTERM, &recover_action, NULL);
     sigaction(SIGFPE, &recover_action, NULL);
@@ -83,82 +356,180 @@ static void ihct_setup_recover_action(void) {
 }
 
 
+// Appends the progress character of a result to the progress line.
 void ihct_print_result(ihct_test_result *result) {
     switch (result->status) {
-    case PASS: fputs(IHCT_BG_GREEN IHCT_BOLD "." IHCT_RESET, stdout); break;
+    case PASS: ihct_strbuf_append(&progress, IHCT_BG_GREEN IHCT_BOLD "." IHCT_RESET); break;
     case FAIL_FORCE:
-    case FAIL: fputs(IHCT_BG_RED IHCT_BOLD ":" IHCT_RESET, stdout); break;
-    case ERR: fputs(IHCT_BG_RED IHCT_BOLD "!" IHCT_RESET, stdout); break;
-    case TIMEOUT: fputs(IHCT_BG_YELLOW IHCT_BOLD "?" IHCT_RESET, stdout); break;
+    case FAIL: ihct_strbuf_append(&progress, IHCT_BG_RED IHCT_BOLD ":" IHCT_RESET); break;
+    case ERR: ihct_strbuf_append(&progress, IHCT_BG_RED IHCT_BOLD "!" IHCT_RESET); break;
+    case TIMEOUT: ihct_strbuf_append(&progress, IHCT_BG_YELLOW IHCT_BOLD "?" IHCT_RESET); break;
+    case REGRESSION: ihct_strbuf_append(&progress, IHCT_BG_MAGENTA IHCT_BOLD "~" IHCT_RESET); break;
     }
 }
-// Reallocates and appends string s to summary_str
+// Appends string s to the summary.
 void ihct_add_to_summary(char *s) {
-    char *p = realloc(summary_str, strlen(summary_str) + strlen(s) + 1);
-    if(!p) {
-        printf("Couldn't allocate a str big enough to hold summary. Aborting.\n");
-        return;
+    ihct_strbuf_append(&summary, s);
+}
+// Adds the detail of a result, indented below it.
+static void ihct_add_detail_to_summary(const char *detail) {
+    while(*detail) {
+        size_t n = strcspn(detail, "\n");
+        ihct_strbuf_append(&summary, "\t");
+        ihct_strbuf_appendn(&summary, detail, n);
+        ihct_strbuf_append(&summary, "\n");
+        detail += n;
+        if(*detail) detail++;
     }
-    summary_str = p;
-    strcat(summary_str, s);
 }
-void ihct_add_error_to_summary(ihct_test_result *res, ihct_unit *unit) {
-    char *msg;
-    char *msg_format;
-    size_t msg_size;
+
+void ihct_add_error_to_summary(const ihct_record *record, const ihct_unit *unit) {
+    if(!text_output) return;
+    const ihct_test_result *res = &record->result;
     switch (res->status) {
     case PASS: break;
     case FAIL:
-        msg_format = IHCT_BOLD "%s:%d: "
+        ihct_strbuf_appendf(&summary, IHCT_BOLD "%s:%lu: "
             IHCT_RESET "assertion in '"
             IHCT_BOLD "%s"
             IHCT_RESET "' "
             IHCT_FG_RED "failed"
             IHCT_RESET ":\n\t'"
             IHCT_FG_YELLOW "%s"
-            IHCT_RESET "'\n";
-        msg_size = snprintf(NULL, 0, msg_format, res->file, res->line,
-            unit->name, res->code) + 1;
-        msg = calloc(msg_size, sizeof(*msg));
-        sprintf(msg, msg_format, res->file, res->line, unit->name, res->code);
+            IHCT_RESET "'\n", res->file, res->line, unit->name, res->code);
     break;
     case FAIL_FORCE:
-        msg_format = IHCT_BOLD "%s:%d: "
+        ihct_strbuf_appendf(&summary, IHCT_BOLD "%s:%lu: "
             IHCT_RESET "'"
             IHCT_BOLD "%s"
             IHCT_RESET "' "
             IHCT_FG_RED "forcefully failed"
-            IHCT_RESET ".\n";
-        msg_size = snprintf(NULL, 0, msg_format, res->file, res->line,
-            unit->name) + 1;
-        msg = calloc(msg_size, sizeof(*msg));
-        sprintf(msg, msg_format, res->file, res->line, unit->name);
+            IHCT_RESET ".\n", res->file, res->line, unit->name);
     break;
     case ERR:
-        msg_format = "unit '"
+        ihct_strbuf_appendf(&summary, "unit '"
             IHCT_BOLD "%s"
             IHCT_RESET "' had to restore because of fatal signal ("
             IHCT_FG_RED "%s"
-            IHCT_RESET ")\n";
-        msg_size = snprintf(NULL, 0, msg_format, unit->name, res->code) + 1;
-        msg = calloc(msg_size, sizeof(*msg));
-        sprintf(msg, msg_format, unit->name, res->code);
+            IHCT_RESET ")\n", unit->name, res->code);
     break;
     case TIMEOUT:
-        msg_format = "unit '"
+        ihct_strbuf_appendf(&summary, "unit '"
             IHCT_BOLD "%s"
             IHCT_RESET "' "
             IHCT_FG_YELLOW "timed out "
             IHCT_RESET "(took "
-            IHCT_FG_YELLOW "5 "
-            IHCT_RESET "seconds).\n";
-        msg_size = snprintf(NULL, 0, msg_format, unit->name) + 1;
-        msg = calloc(msg_size, sizeof(*msg));
-        sprintf(msg, msg_format, unit->name);
+            IHCT_FG_YELLOW "%.1f "
+            IHCT_RESET "ms).\n", unit->name, record->stats.wall * 1e3);
+    break;
+    case REGRESSION:
+        ihct_strbuf_appendf(&summary, "benchmark '"
+            IHCT_BOLD "%s"
+            IHCT_RESET "' "
+            IHCT_FG_MAGENTA "regressed "
+            IHCT_RESET "(%.2f ns/op against %.2f ns/op in baseline, "
+            IHCT_FG_MAGENTA "%+.1f%%"
+            IHCT_RESET ", p = %.2g).\n", unit->name, record->bench->median,
+            record->bench->baseline_median,
+            (record->bench->median / record->bench->baseline_median - 1) * 100,
+            record->bench->p);
+    }
+    if(res->status != PASS && res->detail) ihct_add_detail_to_summary(res->detail);
+}
+
+// Appends a row with the results of a benchmark to the benchmark report.
+static void ihct_add_bench_to_report(ihct_strbuf *report, const ihct_bench_stats *bench,
+                                     const ihct_unit *unit, int name_width) {
+    ihct_strbuf_appendf(report, "%-*s %12.2f %12.2f %10.2f %12zu ", name_width,
+        unit->name, bench->median, bench->min, bench->mad, bench->iterations);
+
+    if(bench->bytes) {
+        double rate = bench->bytes / (bench->median * 1e-9);
+        const char *prefix = " KMGT";
+        while(rate >= 1000 && prefix[1]) {
+            rate /= 1000;
+            prefix++;
+        }
+        ihct_strbuf_appendf(report, "%7.2f %cB/s", rate, *prefix);
+    } else {
+        ihct_strbuf_appendf(report, "%12s", "");
+    }
+
+    if(bench->compared) {
+        ihct_strbuf_appendf(report, " %+9.1f%%", (bench->median / bench->baseline_median - 1) * 100);
+    }
+    ihct_strbuf_append(report, "\n");
+}
+
+// Appends a number of operations per second, scaled to fit 7 characters.
+static void ihct_append_rate(ihct_strbuf *report, double rate) {
+    const char *prefix = " kMGT";
+    while(rate >= 1000 && prefix[1]) {
+        rate /= 1000;
+        prefix++;
+    }
+    if(*prefix == ' ') ihct_strbuf_appendf(report, " %7.2f", rate);
+    else ihct_strbuf_appendf(report, " %6.2f%c", rate, *prefix);
+}
+
+// Adds the operations per second of a concurrent unit, in total and of its
+// threads, to the concurrent report.
+static void ihct_add_concurrent_to_report(ihct_strbuf *report,
+                                          const ihct_concurrent_stats *concurrent,
+                                          const ihct_unit *unit, int name_width) {
+    unsigned n = concurrent->threads;
+    double *sorted = malloc(n * sizeof(*sorted));
+    if(!sorted) {
+        printf("Couldn't allocate memory for concurrent report.\n");
+        exit(EXIT_FAILURE);
+    }
+    double total = 0;
+    for(unsigned k = 0; k < n; k++) total += concurrent->rates[k];
+    memcpy(sorted, concurrent->rates, n * sizeof(*sorted));
+    ihct_stats_sort(sorted, n);
+
+    ihct_strbuf_appendf(report, "%-*s %8u %12zu    ", name_width, unit->name, n,
+                        concurrent->iterations);
+    ihct_append_rate(report, total);
+    ihct_strbuf_append(report, "    ");
+    ihct_append_rate(report, sorted[0]);
+    ihct_strbuf_append(report, "    ");
+    ihct_append_rate(report, ihct_stats_median(sorted, n));
+    ihct_strbuf_append(report, "    ");
+    ihct_append_rate(report, sorted[n - 1]);
+    // Eight threads to a line.
+    for(unsigned k = 0; k < n; k++) {
+        if(k % 8 == 0) ihct_strbuf_append(report, k ? "\n               " : "\n    per thread:");
+        ihct_append_rate(report, concurrent->rates[k]);
     }
-    ihct_add_to_summary(msg);
+    ihct_strbuf_append(report, "\n");
+    free(sorted);
+}
 
-    free(msg);
+// Compares a benchmark to its samples in the baseline, and fails it as a
+// regression if it is significantly slower by more than the threshold.
+static void ihct_compare_to_baseline(ihct_record *record, const ihct_unit *unit) {
+    ihct_bench_stats *bench = record->bench;
+    const ihct_baseline_entry *entry = ihct_baseline_find(&baseline, unit->name);
+    if(!entry || !entry->sample_count) return;
+
+    double *sorted = malloc(entry->sample_count * sizeof(*sorted));
+    if(!sorted) {
+        printf("Couldn't allocate memory for benchmark samples.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(sorted, entry->samples, entry->sample_count * sizeof(*sorted));
+    ihct_stats_sort(sorted, entry->sample_count);
+    bench->baseline_median = ihct_stats_median(sorted, entry->sample_count);
+    free(sorted);
+
+    bench->compared = true;
+    bench->p = ihct_stats_mann_whitney(bench->samples, bench->sample_count,
+                                       entry->samples, entry->sample_count);
+    double change = (bench->median / bench->baseline_median - 1) * 100;
+    if(change > bench_threshold && bench->p < IHCT_REGRESSION_ALPHA) {
+        record->result.status = REGRESSION;
+    }
 }
 
 bool ihct_assert_impl(bool eval, ihct_test_result *result, char *code, char *file,
@@ -187,254 +558,2988 @@ void ihct_fail_impl(ihct_test_result *result, char *file, unsigned long line) {
 }
 
 static ihct_unit *ihct_init_unit(char *name, ihct_test_proc procedure) {
-    ihct_unit *unit = (ihct_unit *)malloc(sizeof(ihct_unit));
+    ihct_unit *unit = (ihct_unit *)calloc(1, sizeof(ihct_unit));
     char *strmem = malloc(strlen(name) + 1);
     strcpy(strmem, name);
     unit->name = strmem;
     unit->procedure = procedure;
+    unit->file = NULL;
+    unit->line = 0;
 
     return unit;
 }
 
 void ihct_construct_test_impl(char *name, ihct_test_proc procedure) {
-    ihct_unit *unit = ihct_init_unit(name, procedure);
-    ihct_vector_add(testunits, unit);
+    ihct_register_unit(ihct_init_unit(name, procedure));
+}
+
+void ihct_register_unit(const ihct_unit *unit) {
+    if(!testunits) ihct_init();
+    ihct_vector_add(testunits, (void *)unit);
+}
+
+void ihct_register_module_units(ihct_module_units *mod) {
+    // A module without units doesn't get a section at all.
+    if(mod->begin == mod->end) return;
+
+    // Every translation unit of a module registers the same section; only keep
+    // the first. Modules are kept in load order.
+    ihct_module_units **p = &module_units;
+    for(; *p; p = &(*p)->next) {
+        if((*p)->begin == mod->begin) return;
+    }
+    size_t count = mod->end - mod->begin;
+    mod->by_name = malloc(count * sizeof(*mod->by_name));
+    if(!mod->by_name) {
+        printf("Couldn't allocate memory for unit index.\n");
+        exit(EXIT_FAILURE);
+    }
+    ihct_filters_index(mod->begin, count, mod->by_name);
+    mod->next = NULL;
+    *p = mod;
 }
 
-static void ihct_unit_free(ihct_unit *unit) {
-    free(unit->name);
-    free(unit);
+void ihct_unregister_module_units(ihct_module_units *mod) {
+    for(ihct_module_units **p = &module_units; *p; p = &(*p)->next) {
+        if(*p == mod) {
+            *p = mod->next;
+            free(mod->by_name);
+            mod->by_name = NULL;
+            return;
+        }
+    }
 }
 
 void ihct_init(void) {
-    // atm, only initializes the unit list. Is this neccessary?
+    // atm, only initializes the fallback unit list.
     testunits = ihct_vector_init();
 }
 
-struct routine_run_unit_data {
-    ihct_test_proc proc;
-    ihct_test_result *result;
-};
+// Load addresses of the modules runs are restricted to, or NULL to run the
+// units of every module. Set with ihct_select_module.
+static ihct_vector *selected_modules;
 
-// Routine run in a separate thread to execute the unit.
-void *routine_run_unit(void *arg) {
-    struct routine_run_unit_data *data = (struct routine_run_unit_data *)arg;
+void ihct_select_module(void *handle) {
+    if(!handle) {
+        if(selected_modules) ihct_vector_free(selected_modules);
+        selected_modules = NULL;
+        return;
+    }
+    struct link_map *map;
+    if(dlinfo(handle, RTLD_DI_LINKMAP, &map)) return;
+    if(!selected_modules) selected_modules = ihct_vector_init();
+    ihct_vector_add(selected_modules, (void *)map->l_addr);
+}
 
-    int old;
-    // Allow the thread to be canceled.
-    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &old);
+// The code of a unit, whatever kind it is.
+static const void *ihct_unit_code(const ihct_unit *u) {
+    switch(u->kind) {
+    case IHCT_UNIT_BENCH: return (const void *)u->bench;
+    case IHCT_UNIT_PARAM: return (const void *)u->param;
+    case IHCT_UNIT_PROPERTY: return (const void *)u->property;
+    case IHCT_UNIT_CONCURRENT: return (const void *)u->concurrent;
+    default: return (const void *)u->procedure;
+    }
+}
 
+// Whether a unit is to be part of this run.
+static bool ihct_unit_selected(const ihct_unit *unit) {
+    if((unit->kind == IHCT_UNIT_BENCH) != test_bench) return false;
+    if(!selected_modules) return true;
+    // A unit belongs to the module its code is in.
+    Dl_info info;
+    if(!dladdr(ihct_unit_code(unit), &info)) return false;
+    for(size_t i = 0; i < selected_modules->size; i++) {
+        if(ihct_vector_get(selected_modules, i) == info.dli_fbase) return true;
+    }
+    return false;
+}
 
-    // Create a jump point, to be able to restore when encountering fatal signal.
-    // When returning here because of a fatal signal, we abort unit with status
-    // ERR. Has to be done inside of thread, refer to man setjmp:
-    // "If, in a multithreaded program, a longjmp() call employs an env
-    // buffer that was initialized by a call to setjmp() in a different
-    // thread, the behavior is undefined.".
-    ihct_setup_recover_action();
-    int restore_status = setjmp(restore_environment);
-    if(restore_status != 0) {
-        char *p = malloc(strlen(strsignal(restore_status)) + 1);
-        strcpy(p, strsignal(restore_status));
-        data->result->code = p;
-        data->result->status = ERR;
+// Orders units of the same file by where they are defined.
+static int ihct_unit_cmp_line(const void *a, const void *b) {
+    const ihct_unit *x = *(const ihct_unit **)a, *y = *(const ihct_unit **)b;
+    if(x->line != y->line) return (x->line > y->line) - (x->line < y->line);
+    return (x->param_index > y->param_index) - (x->param_index < y->param_index);
+}
 
-        // We still want to emit finished signal
-        pthread_mutex_lock(&lock);
-        pthread_cond_signal(&routine_done);
-        pthread_mutex_unlock(&lock);
-        return NULL;
+// Units a parameterized test has been expanded into, and their names. Freed
+// along with the unit list.
+static ihct_vector *expanded;
+
+// The number of units a unit is run as: one for every row of a parameterized
+// test, and one for every slice of the cases of a property.
+static size_t ihct_unit_parts(const ihct_unit *unit) {
+    switch(unit->kind) {
+    case IHCT_UNIT_PARAM: return unit->param_count;
+    case IHCT_UNIT_PROPERTY:
+        return property_cases > IHCT_PROPERTY_SLICE ?
+            (property_cases + IHCT_PROPERTY_SLICE - 1) / IHCT_PROPERTY_SLICE : 1;
+    default: return 1;
+    }
+}
+
+// Adds the units a parameterized test or property is run as to the unit list,
+// those selected by the filters. Only those are allocated.
+static void ihct_expand_unit(const ihct_unit *unit) {
+    size_t parts = ihct_unit_parts(unit);
+    // A property checked by a single unit keeps its name.
+    if(unit->kind == IHCT_UNIT_PROPERTY && parts == 1) {
+        if(ihct_filters_match(&filters, unit)) units[unit_count++] = unit;
+        return;
+    }
+    ihct_unit *rows = NULL;
+    char *name = NULL;
+    for(size_t r = 0; r < parts; r++) {
+        if(!name) name = malloc(strlen(unit->name) + 22);
+        if(!name) {
+            printf("Couldn't allocate memory for unit.\n");
+            exit(EXIT_FAILURE);
+        }
+        sprintf(name, "%s/%zu", unit->name, r);
+        ihct_unit row = *unit;
+        row.name = name;
+        row.param_index = r;
+        if(!ihct_filters_match(&filters, &row)) continue;
+
+        if(!rows) {
+            rows = malloc(parts * sizeof(ihct_unit));
+            if(!rows) {
+                printf("Couldn't allocate memory for unit.\n");
+                exit(EXIT_FAILURE);
+            }
+            ihct_vector_add(expanded, rows);
+        }
+        ihct_vector_add(expanded, name);
+        name = NULL;
+        rows[r] = row;
+        units[unit_count++] = &rows[r];
     }
+    free(name);
+}
 
+// Gathers the registered units selected by the filters into a single list.
+// Units of a module are looked up through its name index, and parameterized
+// tests and properties only expanded into the units selected. Within a module,
+// the units of a translation unit are contiguous but not necessarily in order
+// of definition (the compiler is free to emit them in any order), so they are
+// sorted by line.
+static void ihct_collect_units(void) {
+    unsigned total = testunits ? testunits->size : 0;
+    for(ihct_module_units *m = module_units; m; m = m->next) {
+        for(const ihct_unit *u = m->begin; u != m->end; u++) {
+            total += ihct_unit_parts(u);
+        }
+    }
 
-    // Run test, and save it's result.
-    (*data->proc)(data->result);
+    units = malloc((total ? total : 1) * sizeof(*units));
+    expanded = ihct_vector_init();
+    unit_count = 0;
+    for(ihct_module_units *m = module_units; m; m = m->next) {
+        size_t count = m->end - m->begin;
+        bool *selected = malloc(count * sizeof(*selected));
+        if(!units || !selected) {
+            printf("Couldn't allocate memory for unit list.\n");
+            exit(EXIT_FAILURE);
+        }
+        ihct_filters_select(&filters, m->begin, m->by_name, count, selected);
+        for(size_t k = 0; k < count; k++) {
+            const ihct_unit *u = &m->begin[k];
+            if(!selected[k] || !ihct_unit_selected(u)) continue;
+            if(u->kind == IHCT_UNIT_PARAM || u->kind == IHCT_UNIT_PROPERTY) ihct_expand_unit(u);
+            else units[unit_count++] = u;
+        }
+        free(selected);
+    }
+    for(unsigned i = 0, j; i < unit_count; i = j) {
+        for(j = i + 1; j < unit_count && !strcmp(units[j]->file, units[i]->file); j++);
+        qsort(units + i, j - i, sizeof(*units), ihct_unit_cmp_line);
+    }
+    for(unsigned i = 0; testunits && i < testunits->size; i++) {
+        const ihct_unit *u = ihct_vector_get(testunits, i);
+        if(ihct_unit_selected(u) && ihct_filters_match(&filters, u)) units[unit_count++] = u;
+    }
+}
 
-    // Emit signal that thread is finished.
-    pthread_mutex_lock(&lock);
-    pthread_cond_signal(&routine_done);
-    pthread_mutex_unlock(&lock);
-    return NULL;
+// Frees the unit list, and the units expanded into it.
+static void ihct_free_units(void) {
+    for(size_t i = 0; i < expanded->size; i++) free(ihct_vector_get(expanded, i));
+    ihct_vector_free(expanded);
+    free(units);
 }
 
-static ihct_test_result *ihct_run_specific(ihct_unit *unit) {
-    // Allocate memory for the tests result, and set it to passed by default.
-    ihct_test_result *result = malloc(sizeof(ihct_test_result));
-    result->status = PASS;
+// Writes out the pending part of the progress line.
+static void ihct_flush_progress(void) {
+    if(text_output) ihct_strbuf_flush(&progress, stdout);
+    else progress.len = 0;
+    if(report_out) fflush(report_out);
+    clock_gettime(CLOCK_MONOTONIC, &progress_flushed);
+}
 
-    // lock current thread.
-    pthread_mutex_lock(&lock);
+// Whether the progress line was last written out more than IHCT_PROGRESS_INTERVAL ago.
+static bool ihct_progress_due(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long since = (now.tv_sec - progress_flushed.tv_sec) * 1000000000LL +
+        (now.tv_nsec - progress_flushed.tv_nsec);
+    return since >= IHCT_PROGRESS_INTERVAL;
+}
 
-    // Create a separate thread to run the test in. We set a limited time
-    // the process may be run, and abort if it times out.
-    struct timespec timeout;
-    clock_gettime(CLOCK_REALTIME, &timeout);
-    timeout.tv_sec += test_timeout;
+static void timespec_add_ms(struct timespec *t, long ms) {
+    t->tv_sec += ms / 1000;
+    t->tv_nsec += (ms % 1000) * 1000000;
+    if(t->tv_nsec >= 1000000000) {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000;
+    }
+}
 
-    // Create a temporary data struct to carry data into thread.
-    struct routine_run_unit_data data = {unit->procedure, result};
+// Parses a duration, such as "50ms", "2s" or "1.5m", into milliseconds. A plain
+// number is in seconds. Returns false if it isn't a duration.
+static bool ihct_parse_duration(const char *s, long *ms) {
+    char *end;
+    double v = strtod(s, &end);
+    if(end == s || v < 0) return false;
+
+    double scale;
+    if(!*end || !strcmp(end, "s")) scale = 1000;
+    else if(!strcmp(end, "ms")) scale = 1;
+    else if(!strcmp(end, "m")) scale = 60000;
+    else return false;
+    *ms = v * scale + 0.5;
+    // Anything shorter than a millisecond still gets one.
+    if(*ms == 0 && v > 0) *ms = 1;
+    return true;
+}
 
-    // Create new thread to run the unit routine.
-    pthread_t tid;
-    pthread_cond_init(&routine_done, NULL);
-    pthread_create(&tid, NULL, routine_run_unit, &data);
+static int timespec_cmp(const struct timespec *a, const struct timespec *b) {
+    if(a->tv_sec != b->tv_sec) return a->tv_sec < b->tv_sec ? -1 : 1;
+    if(a->tv_nsec != b->tv_nsec) return a->tv_nsec < b->tv_nsec ? -1 : 1;
+    return 0;
+}
 
-    int err =  pthread_cond_timedwait(&routine_done, &lock, &timeout);
+// Stops handing out units. Any worker picking up a unit after the exchange gets
+// an index past the last one, and stops. Called with result_lock held.
+static void ihct_stop_scheduling(void) {
+    if(scheduling_stopped) return;
+    unsigned next = __atomic_exchange_n(&next_unit, slot_count, __ATOMIC_RELAXED);
+    scheduled_count = next < slot_count ? next : slot_count;
+    scheduling_stopped = true;
+    pthread_cond_broadcast(&result_ready);
+}
 
-    pthread_mutex_unlock(&lock);
+// Hands a finished record to the collecting thread.
+static void ihct_publish_record(unsigned i, ihct_record *record) {
+    pthread_mutex_lock(&result_lock);
+    records[i] = record;
+    if(record->result.status != PASS && max_failures > 0 &&
+       ++published_failures >= (unsigned long)max_failures) {
+        ihct_stop_scheduling();
+    }
+    pthread_cond_broadcast(&result_ready);
+    pthread_mutex_unlock(&result_lock);
+}
 
-    // If timed out, force quit thread and return TIMEOUT.
-    // Note that this is not safe memory. There is a high chance that
-    // the thread may not be freed. Looking into solving this.
-    if(err == ETIMEDOUT) {
-        pthread_cancel(tid);
+void ihct_bench_set_bytes(size_t bytes) {
+    bench_bytes = bytes;
+}
 
-        result->status = TIMEOUT;
-        return result;
+// Runs a benchmark for a single sample, and returns the time it took in
+// nanoseconds.
+static double ihct_bench_sample(const ihct_unit *unit, ihct_test_result *result,
+                                size_t iterations) {
+    struct timespec tbegin, tend;
+    clock_gettime(CLOCK_MONOTONIC, &tbegin);
+    (*unit->bench)(result, iterations);
+    clock_gettime(CLOCK_MONOTONIC, &tend);
+    return (tend.tv_sec - tbegin.tv_sec) * 1e9 + (tend.tv_nsec - tbegin.tv_nsec);
+}
+
+// Runs a benchmark, calibrating the number of iterations until a sample takes
+// at least bench_time, and then takes bench_samples samples. Stops at the first
+// failed sample.
+static void ihct_run_bench(const ihct_unit *unit, ihct_record *record) {
+    ihct_test_result *result = &record->result;
+    double min_time = bench_time * 1e6;
+    bench_bytes = 0;
+
+    size_t iterations = 1;
+    for(;;) {
+        double t = ihct_bench_sample(unit, result, iterations);
+        if(result->status != PASS) return;
+        if(t >= min_time) break;
+
+        // Aim a bit past the minimum time, but grow by at most 10 times per step
+        // since timings of short samples are not to be trusted.
+        double factor = t > 0 ? min_time * 1.2 / t : 10;
+        if(factor < 2) factor = 2;
+        if(factor > 10) factor = 10;
+        iterations *= factor;
     }
 
-    //pthread_join(procedure, NULL);
-    pthread_join(tid, NULL);
+    for(int i = 0; i < IHCT_BENCH_WARMUP; i++) {
+        ihct_bench_sample(unit, result, iterations);
+        if(result->status != PASS) return;
+    }
 
-    // Run test, and save it's result into i.
-    //(*unit->procedure)(result);
+    double *samples = malloc(bench_samples * sizeof(*samples));
+    if(!samples) {
+        printf("Couldn't allocate memory for benchmark samples.\n");
+        exit(EXIT_FAILURE);
+    }
+    for(long i = 0; i < bench_samples; i++) {
+        samples[i] = ihct_bench_sample(unit, result, iterations) / iterations;
+        if(result->status != PASS) {
+            free(samples);
+            return;
+        }
+    }
 
-    return result;
+    ihct_bench_stats *bench = malloc(sizeof(*bench));
+    double *sorted = malloc(bench_samples * sizeof(*sorted));
+    if(!bench || !sorted) {
+        printf("Couldn't allocate memory for benchmark samples.\n");
+        exit(EXIT_FAILURE);
+    }
+    bench->iterations = iterations;
+    bench->bytes = bench_bytes;
+    bench->sample_count = bench_samples;
+    bench->samples = samples;
+
+    memcpy(sorted, samples, bench_samples * sizeof(*sorted));
+    ihct_stats_sort(sorted, bench_samples);
+    bench->min = sorted[0];
+    bench->median = ihct_stats_median(sorted, bench_samples);
+    bench->mad = ihct_stats_mad(sorted, bench_samples, bench->median);
+    free(sorted);
+
+    record->bench = bench;
 }
 
-int ihct_run(int argc, char **argv) {
-    unsigned unit_count = testunits->size;
-    // Allocate results
-    ihct_results = calloc(unit_count, sizeof(ihct_test_result *));
+// The allocation tracker, when the program is linked with (or preloaded)
+// ihct_alloc. Found on startup; the runner's own library never depends on it.
+static struct {
+    void (*begin)(void);
+    void (*end)(ihct_alloc_stats *);
+    void (*read)(ihct_alloc_stats *);
+    void (*pause)(void);
+    void (*resume)(void);
+} alloc_hooks;
+
+static void ihct_find_alloc_hooks(void) {
+    alloc_hooks.begin = (void (*)(void))dlsym(RTLD_DEFAULT, "ihct_alloc_begin");
+    alloc_hooks.end = (void (*)(ihct_alloc_stats *))dlsym(RTLD_DEFAULT, "ihct_alloc_end");
+    alloc_hooks.read = (void (*)(ihct_alloc_stats *))dlsym(RTLD_DEFAULT, "ihct_alloc_read");
+    alloc_hooks.pause = (void (*)(void))dlsym(RTLD_DEFAULT, "ihct_alloc_pause");
+    alloc_hooks.resume = (void (*)(void))dlsym(RTLD_DEFAULT, "ihct_alloc_resume");
+    if(!alloc_hooks.begin || !alloc_hooks.end || !alloc_hooks.read || !alloc_hooks.pause ||
+       !alloc_hooks.resume) {
+        memset(&alloc_hooks, 0, sizeof(alloc_hooks));
+    }
+}
 
-    unsigned failed_count = 0;
+// Virtual time, from ihct_time, if the program is linked with it or has it
+// preloaded.
+static struct {
+    void (*begin)(void);
+    void (*end)(void);
+    void (*shift)(uint64_t ns);
+} time_hooks;
+
+static void ihct_find_time_hooks(void) {
+    time_hooks.begin = (void (*)(void))dlsym(RTLD_DEFAULT, "ihct_time_begin");
+    time_hooks.end = (void (*)(void))dlsym(RTLD_DEFAULT, "ihct_time_end");
+    time_hooks.shift = (void (*)(uint64_t))dlsym(RTLD_DEFAULT, "ihct_time_shift");
+    if(!time_hooks.begin || !time_hooks.end || !time_hooks.shift) {
+        memset(&time_hooks, 0, sizeof(time_hooks));
+    }
+}
 
-    // initialize the summary string
-    summary_str = malloc(sizeof(char));
-    *summary_str = '\0';
+// Set while the thread runs a test with virtual time. Ended before the unit is
+// measured, which is done in real time.
+static __thread bool time_virtual;
 
-    // handle args
-    int c;
-    while((c = getopt(argc, argv, "t:")) != -1) {
-        switch(c) {
-        case 't':
-            test_timeout = atoi(optarg);
-            break;
-        case '?':
-            printf("unknown option '%c'.\n", optopt);
-        }
+static void ihct_time_start(void) {
+    if(!time_hooks.begin) return;
+    time_virtual = true;
+    time_hooks.begin();
+}
+
+static void ihct_time_stop(void) {
+    if(!time_virtual) return;
+    time_virtual = false;
+    time_hooks.end();
+}
+
+void ihct_time_advance(double seconds) {
+    if(seconds <= 0) return;
+    uint64_t ns = seconds * 1e9;
+    if(time_virtual) {
+        time_hooks.shift(ns);
+        return;
     }
+    struct timespec t = {ns / 1000000000, ns % 1000000000};
+    while(nanosleep(&t, &t) != 0 && errno == EINTR);
+}
 
-    // start clock
-    struct timespec tbegin, tend;
-    clock_gettime(CLOCK_MONOTONIC, &tbegin);
+// Allocations are tracked in tests only. The runner allocates the samples of a
+// benchmark itself, and those would only get in the way.
+static __thread bool alloc_tracking;
 
-    // Iterate over every test
-    for(unsigned i = 0; i < unit_count; i++) {
-        ihct_unit *unit = ihct_vector_get(testunits, i);
+static void ihct_alloc_start(void) {
+    if(!alloc_hooks.begin) return;
+    alloc_tracking = true;
+    alloc_hooks.begin();
+}
 
-        ihct_results[i] = ihct_run_specific(unit);
+static void ihct_alloc_stop(ihct_unit_stats *stats) {
+    if(!alloc_tracking) return;
+    alloc_tracking = false;
+    alloc_hooks.end(&stats->allocs);
+}
 
-        // ensure 80 width
-        if(i % 80 == 0 && i != 0) putc('\n', stdout);
+unsigned long ihct_alloc_count(void) {
+    if(!alloc_tracking) return 0;
+    ihct_alloc_stats stats;
+    alloc_hooks.read(&stats);
+    return stats.allocs;
+}
 
-        ihct_print_result(ihct_results[i]);
-        fflush(stdout);
+bool ihct_assert_max_allocs_impl(unsigned long max, ihct_test_result *result, char *code,
+                                 char *file, unsigned long line) {
+    return ihct_assert_impl(ihct_alloc_count() <= max, result, code, file, line);
+}
 
-        if(ihct_results[i]->status) {
-            failed_count++;
-            ihct_add_error_to_summary(ihct_results[i], unit);
-        }
-        // Frees both the unit and the result.
-        ihct_unit_free(unit);
+// Allocations made by fixtures, or for the details of a failure, are never
+// counted against a unit.
+static void ihct_alloc_pause_tracking(bool pause) {
+    if(!alloc_tracking) return;
+    if(pause) alloc_hooks.pause();
+    else alloc_hooks.resume();
+}
+
+void ihct_assert_fail(ihct_test_result *result, char *code, char *file, unsigned long line) {
+    result->status = FAIL;
+    result->file = file;
+    result->line = line;
+    result->code = code;
+}
+
+// A detail of a failure is written with tracking paused, and handed over to the
+// result, which frees it.
+static void ihct_assert_detail_begin(ihct_strbuf *detail) {
+    ihct_alloc_pause_tracking(true);
+    ihct_strbuf_init(detail);
+}
+
+static void ihct_assert_detail_end(ihct_test_result *result, ihct_strbuf *detail) {
+    free(result->detail);
+    result->detail = detail->data;
+    ihct_alloc_pause_tracking(false);
+}
+
+// Fails the unit, with a detail noting the value of each operand.
+__attribute__((format(printf, 5, 6)))
+static void ihct_assert_fail_values(ihct_test_result *result, char *code, char *file,
+                                    unsigned long line, const char *fmt, ...) {
+    ihct_assert_fail(result, code, file, line);
+    ihct_strbuf detail;
+    ihct_assert_detail_begin(&detail);
+    va_list args;
+    va_start(args, fmt);
+    ihct_strbuf_vappendf(&detail, fmt, args);
+    va_end(args);
+    ihct_assert_detail_end(result, &detail);
+}
+
+void ihct_assert_fail_mem(ihct_test_result *result, const void *a, const void *b, size_t n,
+                          size_t offset, char *code, char *file, unsigned long line) {
+    ihct_assert_fail(result, code, file, line);
+    ihct_strbuf detail;
+    ihct_assert_detail_begin(&detail);
+    ihct_memdiff_hexdump(&detail, a, b, n, offset);
+    ihct_assert_detail_end(result, &detail);
+}
+
+void ihct_assert_fail_str(ihct_test_result *result, const char *s1, const char *s2,
+                          size_t offset, char *code, char *file, unsigned long line) {
+    ihct_assert_fail(result, code, file, line);
+    ihct_strbuf detail;
+    ihct_assert_detail_begin(&detail);
+    ihct_memdiff_strings(&detail, s1, s2, offset);
+    ihct_assert_detail_end(result, &detail);
+}
+
+void ihct_assert_fail_int(ihct_test_result *result, long long a, long long b, char *code,
+                          char *sa, char *sb, char *file, unsigned long line) {
+    ihct_assert_fail_values(result, code, file, line, "%s = %lld\n%s = %lld", sa, a, sb, b);
+}
+
+void ihct_assert_fail_uint(ihct_test_result *result, unsigned long long a,
+                           unsigned long long b, char *code, char *sa, char *sb, char *file,
+                           unsigned long line) {
+    ihct_assert_fail_values(result, code, file, line, "%s = %llu (%#llx)\n%s = %llu (%#llx)",
+                            sa, a, a, sb, b, b);
+}
 
-        // Also frees dynamic allocated string if status is err (the signal name).
-        if(ihct_results[i]->status == ERR) free(ihct_results[i]->code);
+void ihct_assert_fail_ptr(ihct_test_result *result, const void *a, const void *b, char *code,
+                          char *sa, char *sb, char *file, unsigned long line) {
+    ihct_assert_fail_values(result, code, file, line, "%s = %p\n%s = %p", sa, a, sb, b);
+}
 
-        free(ihct_results[i]);
+void ihct_assert_fail_dbl(ihct_test_result *result, double a, double b, char *code,
+                          char *sa, char *sb, char *file, unsigned long line) {
+    unsigned long long ulps = ihct_dbl_ulps(a, b);
+    if(ulps == ~0ULL) {
+        ihct_assert_fail_values(result, code, file, line, "%s = %.17g\n%s = %.17g", sa, a,
+                                sb, b);
+    } else {
+        ihct_assert_fail_values(result, code, file, line,
+                                "%s = %.17g\n%s = %.17g\n%llu ulps apart", sa, a, sb, b, ulps);
     }
-    free(ihct_results);
-    ihct_vector_free(testunits);
+}
 
-    clock_gettime(CLOCK_MONOTONIC, &tend);
-    double elapsed = (tend.tv_sec - tbegin.tv_sec);
-    elapsed += (tend.tv_nsec - tbegin.tv_nsec) / 1000000000.0;
+// Fixtures. Run and suite fixtures have one instance for the whole run, or for
+// each suite (the units of a file), shared by all workers. Test fixtures have
+// an instance for every unit requiring them, kept by the thread running it.
+typedef struct ihct_fixture_instance {
+    ihct_fixture *fixture;
+    unsigned suite;
+    // Held while setting up, so units requiring it meanwhile wait for it.
+    pthread_mutex_t lock;
+    enum {IHCT_FIXTURE_NEW, IHCT_FIXTURE_READY, IHCT_FIXTURE_FAILED} state;
+    void *data;
+    struct ihct_fixture_instance *next;
+} ihct_fixture_instance;
+
+static ihct_fixture_instance *fixture_instances;
+static pthread_mutex_t fixtures_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread ihct_fixture_instance *test_fixtures;
+// The instance being set up by this thread, if any, for when the setup crashes.
+static __thread ihct_fixture_instance *fixture_in_setup;
+
+// The suite of every unit, and the number of units of every suite still to be
+// done, to tell when its fixtures can be torn down.
+static unsigned *unit_suites;
+static unsigned *suite_remaining;
+static __thread unsigned current_suite;
+
+static int ihct_unit_cmp_file(const void *a, const void *b) {
+    return strcmp(units[*(const unsigned *)a]->file, units[*(const unsigned *)b]->file);
+}
 
-    // print all messages
-    if(strlen(summary_str) > 4) printf("\n\n%s\n", summary_str);
-    else puts("\n\n");
+// Groups the units into suites by the file they are defined in.
+static void ihct_collect_suites(void) {
+    unsigned *order = malloc((unit_count ? unit_count : 1) * sizeof(unsigned));
+    unit_suites = malloc((unit_count ? unit_count : 1) * sizeof(unsigned));
+    suite_remaining = calloc(unit_count + 1, sizeof(unsigned));
+    if(!order || !unit_suites || !suite_remaining) {
+        printf("Couldn't allocate memory for suites.\n");
+        exit(EXIT_FAILURE);
+    }
+    for(unsigned i = 0; i < unit_count; i++) order[i] = i;
+    qsort(order, unit_count, sizeof(unsigned), ihct_unit_cmp_file);
 
-    // Free summary str
-    free(summary_str);
+    unsigned suite = 0;
+    for(unsigned k = 0; k < unit_count; k++) {
+        if(k > 0 && ihct_unit_cmp_file(&order[k - 1], &order[k]) != 0) suite++;
+        unit_suites[order[k]] = suite;
+    }
+    free(order);
+}
 
-    printf("tests took %.2f seconds\n", elapsed);
-    if(failed_count) {
-        char *status_format = IHCT_FG_GREEN "%d successful "
-            IHCT_RESET "and "
-            IHCT_FG_RED "%d failed "
-            IHCT_RESET "of "
-            IHCT_FG_YELLOW "%d run"
-            IHCT_RESET "\n";
-        printf(status_format, unit_count-failed_count, failed_count,
-               unit_count);
+// Counts the units left of every suite, for a round running every unit the
+// given number of times.
+static void ihct_count_suite_units(unsigned copies) {
+    memset(suite_remaining, 0, (unit_count + 1) * sizeof(unsigned));
+    for(unsigned i = 0; i < unit_count; i++) suite_remaining[unit_suites[i]] += copies;
+}
 
-        printf(IHCT_FG_RED "FAILURE\n" IHCT_RESET);
-        return 1;
+static ihct_fixture_instance *ihct_fixture_instance_new(ihct_fixture *fixture, unsigned suite) {
+    ihct_fixture_instance *inst = calloc(1, sizeof(*inst));
+    if(!inst) {
+        printf("Couldn't allocate memory for fixture.\n");
+        exit(EXIT_FAILURE);
     }
+    inst->fixture = fixture;
+    inst->suite = suite;
+    pthread_mutex_init(&inst->lock, NULL);
+    return inst;
+}
 
-    char *status_format = IHCT_FG_GREEN "%d successful "
-        IHCT_RESET "of "
-        IHCT_FG_YELLOW "%d run"
-        IHCT_RESET "\n";
-    printf(status_format, unit_count, unit_count);
+// Tears down and frees a list of instances.
+static void ihct_fixtures_free(ihct_fixture_instance *inst) {
+    ihct_alloc_pause_tracking(true);
+    while(inst) {
+        ihct_fixture_instance *next = inst->next;
+        if(inst->state == IHCT_FIXTURE_READY && inst->fixture->teardown) {
+            inst->fixture->teardown(inst->data);
+        }
+        pthread_mutex_destroy(&inst->lock);
+        free(inst);
+        inst = next;
+    }
+    ihct_alloc_pause_tracking(false);
+}
 
-    printf(IHCT_FG_GREEN "SUCCESS\n" IHCT_RESET);
-    return 0;
+// Marks an instance whose setup never returned as failed, and lets the units
+// waiting on it go. Its setup either crashed, or was canceled along with a unit
+// timed out.
+static void ihct_fixture_setup_failed(void *arg) {
+    ihct_fixture_instance *inst = arg;
+    inst->state = IHCT_FIXTURE_FAILED;
+    fixture_in_setup = NULL;
+    pthread_mutex_unlock(&inst->lock);
 }
 
-// Lets the program run tests on itself. This is done with the compiler flag
-// IHCT_TEST_SELF. Still requires an external main entrypoint.
-#ifdef IHCT_TEST_SELF
+bool ihct_require_impl(ihct_fixture *fixture, void **data, ihct_test_result *result,
+                       char *file, unsigned long line) {
+    // Canceled midway (the unit timed out), the unit would leave the fixtures
+    // or the heap locked; only the setup itself may be canceled.
+    int cancel_state;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+    ihct_alloc_pause_tracking(true);
+    ihct_fixture_instance *inst;
+    if(fixture->scope == IHCT_SCOPE_TEST) {
+        for(inst = test_fixtures; inst && inst->fixture != fixture; inst = inst->next);
+        if(!inst) {
+            inst = ihct_fixture_instance_new(fixture, 0);
+            inst->next = test_fixtures;
+            test_fixtures = inst;
+        }
+    } else {
+        unsigned suite = fixture->scope == IHCT_SCOPE_SUITE ? current_suite : 0;
+        pthread_mutex_lock(&fixtures_lock);
+        for(inst = fixture_instances; inst; inst = inst->next) {
+            if(inst->fixture == fixture && inst->suite == suite) break;
+        }
+        if(!inst) {
+            inst = ihct_fixture_instance_new(fixture, suite);
+            inst->next = fixture_instances;
+            fixture_instances = inst;
+        }
+        pthread_mutex_unlock(&fixtures_lock);
+    }
 
-// Create two internal test procedures, for testing the test creation.
-static void itest_true(ihct_test_result *result) {
-    IHCT_ASSERT(true);
+    pthread_mutex_lock(&inst->lock);
+    if(inst->state == IHCT_FIXTURE_NEW) {
+        pthread_cleanup_push(&ihct_fixture_setup_failed, inst);
+        fixture_in_setup = inst;
+        pthread_setcancelstate(cancel_state, NULL);
+        inst->data = fixture->setup();
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        fixture_in_setup = NULL;
+        inst->state = IHCT_FIXTURE_READY;
+        pthread_cleanup_pop(false);
+    }
+    bool ready = inst->state == IHCT_FIXTURE_READY;
+    *data = inst->data;
+    pthread_mutex_unlock(&inst->lock);
+    ihct_alloc_pause_tracking(false);
+    pthread_setcancelstate(cancel_state, NULL);
+
+    if(!ready) {
+        result->status = FAIL;
+        result->code = "fixture couldn't be set up";
+        result->file = file;
+        result->line = line;
+    }
+    return ready;
 }
-static void itest_false(ihct_test_result *result) {
-    IHCT_ASSERT(false);
+
+// Called when the running unit crashed. A fixture it was setting up is marked
+// as failed, and its test fixtures are dropped without a teardown; neither can
+// be trusted anymore.
+static void ihct_fixtures_crashed(void) {
+    if(fixture_in_setup) ihct_fixture_setup_failed(fixture_in_setup);
+    while(test_fixtures) {
+        ihct_fixture_instance *next = test_fixtures->next;
+        pthread_mutex_destroy(&test_fixtures->lock);
+        free(test_fixtures);
+        test_fixtures = next;
+    }
 }
 
-IHCT_TEST(self_unit_create) {
-    ihct_unit *u = ihct_init_unit("internal_true", &itest_true);
-    IHCT_ASSERT_STR(u->name, "internal_true");
-    IHCT_ASSERT(&itest_true == u->procedure);
+// Tears down the fixtures of a suite, or all shared fixtures.
+static void ihct_teardown_fixtures(bool all, unsigned suite) {
+    ihct_fixture_instance *done = NULL;
+    pthread_mutex_lock(&fixtures_lock);
+    ihct_fixture_instance **p = &fixture_instances;
+    while(*p) {
+        ihct_fixture_instance *inst = *p;
+        if(all || (inst->fixture->scope == IHCT_SCOPE_SUITE && inst->suite == suite)) {
+            *p = inst->next;
+            inst->next = done;
+            done = inst;
+        } else {
+            p = &inst->next;
+        }
+    }
+    pthread_mutex_unlock(&fixtures_lock);
+    ihct_fixtures_free(done);
 }
 
-IHCT_TEST(self_vector_create) {
-    ihct_vector *v = ihct_init_vector();
+// Called once a unit is done, or won't be run. Tears down the fixtures of its
+// suite after its last unit.
+static void ihct_unit_done(unsigned i) {
+    if(--suite_remaining[unit_suites[i]] == 0) ihct_teardown_fixtures(false, unit_suites[i]);
+}
 
-    IHCT_ASSERT(v != NULL);
-    IHCT_ASSERT(v->data == NULL);
-    IHCT_ASSERT(v->size == 0);
+// Writes a done unit to the reporter. The record is NULL for a unit not run.
+static void ihct_report_unit_done(unsigned index, unsigned i, const ihct_record *record) {
+    if(!reporter) return;
+    bool ran = record && !record->cached && !record->skipped;
+    ihct_report_unit u = {index, units[i], ran ? &record->result : NULL, record && record->cached,
+                          ran ? record->stats.wall : 0,
+                          ran && record->bench ? record->bench->median : 0};
+    reporter->unit(report_out, &u);
+}
 
-    ihct_free_vector(v);
+// Runs a thread of a concurrent unit, failing the thread instead of the run
+// if it crashes. Fixtures it requires are those of the suite of the unit.
+static void ihct_concurrent_guard(ihct_concurrent_thread *t, void *suite) {
+    current_suite = (uintptr_t)suite;
+    int restore_status = sigsetjmp(restore_environment, 1);
+    if(restore_status != 0) {
+        restore_armed = false;
+        ihct_fixtures_crashed();
+        ihct_test_result *result = ihct_concurrent_result(t);
+        result->code = strdup(strsignal(restore_status));
+        result->status = ERR;
+        return;
+    }
+    restore_armed = true;
+    ihct_concurrent_body(t);
+    restore_armed = false;
+    ihct_fixtures_free(test_fixtures);
+    test_fixtures = NULL;
 }
 
-IHCT_TEST(self_vector_all) {
-    ihct_vector *v = ihct_init_vector();
+// Runs the body of a unit, whatever kind it is.
+static void ihct_exec_unit(unsigned i, ihct_record *record) {
+    const ihct_unit *unit = units[i];
+    current_suite = unit_suites[i];
+    switch(unit->kind) {
+    case IHCT_UNIT_TEST:
+        // Run in real time, it would sleep for as long as it means to skip.
+        if(unit->virtual_time && !time_hooks.begin) {
+            record->result = (ihct_test_result){FAIL, "virtual time unavailable",
+                (char *)unit->file, unit->line,
+                strdup("link the test program with ihct_time, or preload it")};
+            break;
+        }
+        ihct_alloc_start();
+        if(unit->virtual_time) ihct_time_start();
+        (*unit->procedure)(&record->result);
+        ihct_time_stop();
+        ihct_fixtures_free(test_fixtures);
+        test_fixtures = NULL;
+        ihct_alloc_stop(&record->stats);
+        break;
+    case IHCT_UNIT_PARAM:
+        ihct_alloc_start();
+        (*unit->param)(&record->result,
+                       (const char *)unit->params + unit->param_index * unit->param_size,
+                       unit->param_index);
+        ihct_fixtures_free(test_fixtures);
+        test_fixtures = NULL;
+        ihct_alloc_stop(&record->stats);
+        break;
+    case IHCT_UNIT_PROPERTY: {
+        unsigned long first = unit->param_index * IHCT_PROPERTY_SLICE;
+        unsigned long count = property_cases - first;
+        if(count > IHCT_PROPERTY_SLICE) count = IHCT_PROPERTY_SLICE;
+        ihct_alloc_start();
+        ihct_property_run(unit->property, &record->result,
+                          ihct_property_seed(property_seed, unit->name), property_seed,
+                          first, count, &ihct_alloc_pause_tracking);
+        ihct_fixtures_free(test_fixtures);
+        test_fixtures = NULL;
+        ihct_alloc_stop(&record->stats);
+        break;
+    }
+    case IHCT_UNIT_BENCH:
+        ihct_run_bench(unit, record);
+        ihct_fixtures_free(test_fixtures);
+        test_fixtures = NULL;
+        break;
+    case IHCT_UNIT_CONCURRENT: {
+        // Allocations are made on threads of their own, so they aren't tracked.
+        ihct_concurrent_stats stats;
+        ihct_concurrent_run(unit, &record->result, ihct_property_seed(property_seed, unit->name),
+                            property_seed, &stats, &ihct_concurrent_guard,
+                            (void *)(uintptr_t)current_suite);
+        record->concurrent = malloc(sizeof(stats));
+        if(!record->concurrent) {
+            printf("Couldn't allocate memory for concurrent unit.\n");
+            exit(EXIT_FAILURE);
+        }
+        *record->concurrent = stats;
+        break;
+    }
+    }
+}
 
-    for(int i = 0; i < 1000; ++i) {
-        int *t = malloc(sizeof(int));
-        *t = i * 2;
-        ihct_vector_add(v, t);
+// Frees everything a record owns, but not the record itself.
+static void ihct_record_clear(ihct_record *record) {
+    // Also frees dynamic allocated string if status is err (the signal name).
+    if(record->result.status == ERR) free(record->result.code);
+    free(record->result.detail);
+    if(record->bench) {
+        free(record->bench->samples);
+        free(record->bench);
     }
+    if(record->concurrent) {
+        free(record->concurrent->rates);
+        free(record->concurrent);
+    }
+}
 
-    for(int i = 0; i < 1000; ++i) {
-        int *t = ihct_vector_get(v, i);
-        IHCT_ASSERT(i * 2 == *t);
-        free(t);
+// Perf event counters of the calling thread, opened on first use. Closed by a
+// destructor of counters_key as the thread exits, or is canceled.
+static __thread ihct_counters *thread_counters;
+static pthread_key_t counters_key;
+static pthread_once_t counters_key_once = PTHREAD_ONCE_INIT;
+
+static void ihct_counters_destroy(void *arg) {
+    ihct_counters_close(arg);
+    free(arg);
+}
+
+static void ihct_counters_key_create(void) {
+    pthread_key_create(&counters_key, &ihct_counters_destroy);
+}
+
+// Returns the counters of the calling thread, or NULL if none could be opened.
+static ihct_counters *ihct_thread_counters(void) {
+    if(thread_counters) return thread_counters;
+
+    ihct_counters *c = malloc(sizeof(*c));
+    if(!c) {
+        printf("Couldn't allocate memory for counters.\n");
+        exit(EXIT_FAILURE);
+    }
+    if(!ihct_counters_open(c)) {
+        free(c);
+        return NULL;
+    }
+    pthread_once(&counters_key_once, &ihct_counters_key_create);
+    pthread_setspecific(counters_key, c);
+    thread_counters = c;
+    return c;
+}
+
+bool ihct_assert_max_instructions_impl(unsigned long long max, ihct_test_result *result,
+                                       char *code, char *file, unsigned long line) {
+    // Only counted with --counters, and a PMU to count with.
+    ihct_counter_values v;
+    if(!test_counters || !thread_counters) return ihct_assert_impl(true, result, code, file, line);
+    ihct_counters_read(thread_counters, &v);
+    bool eval = !(v.available & 1u << IHCT_COUNTER_INSTRUCTIONS) ||
+                v.values[IHCT_COUNTER_INSTRUCTIONS] <= max;
+    return ihct_assert_impl(eval, result, code, file, line);
+}
+
+// Measurements taken when a unit starts, to subtract from those taken after.
+typedef struct {
+    struct timespec wall;
+    struct timespec cpu;
+    struct rusage usage;
+    ihct_counters *counters;
+} ihct_probe;
+
+static double timespec_since(const struct timespec *begin, const struct timespec *end) {
+    return (end->tv_sec - begin->tv_sec) + (end->tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+static void ihct_probe_begin(ihct_probe *probe) {
+    probe->counters = test_counters ? ihct_thread_counters() : NULL;
+    getrusage(RUSAGE_THREAD, &probe->usage);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &probe->cpu);
+    clock_gettime(CLOCK_MONOTONIC, &probe->wall);
+    if(probe->counters) ihct_counters_start(probe->counters);
+}
+
+static void ihct_probe_end(const ihct_probe *probe, ihct_unit_stats *stats) {
+    struct timespec wall, cpu;
+    struct rusage usage;
+    if(probe->counters) {
+        ihct_counters_stop(probe->counters);
+        ihct_counters_read(probe->counters, &stats->counters);
     }
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    getrusage(RUSAGE_THREAD, &usage);
+
+    stats->wall = timespec_since(&probe->wall, &wall);
+    stats->cpu = timespec_since(&probe->cpu, &cpu);
+    stats->minflt = usage.ru_minflt - probe->usage.ru_minflt;
+    stats->majflt = usage.ru_majflt - probe->usage.ru_majflt;
+    stats->nvcsw = usage.ru_nvcsw - probe->usage.ru_nvcsw;
+    stats->nivcsw = usage.ru_nivcsw - probe->usage.ru_nivcsw;
+    stats->maxrss = usage.ru_maxrss;
+}
+
+// Most units a batch of rows may have.
+#define IHCT_BATCH_MAX 64
+
+// Splits consecutive rows of the same parameterized test into batches, small
+// enough for every worker to get a few of them.
+static void ihct_batch_units(void) {
+    unit_batches = malloc((unit_count ? unit_count : 1) * sizeof(unsigned));
+    if(!unit_batches) {
+        printf("Couldn't allocate memory for batches.\n");
+        exit(EXIT_FAILURE);
+    }
+    for(unsigned i = 0, j; i < unit_count; i = j) {
+        const ihct_unit *u = units[i];
+        for(j = i + 1; j < unit_count && u->kind == IHCT_UNIT_PARAM &&
+            units[j]->kind == IHCT_UNIT_PARAM && units[j]->params == u->params; j++);
+
+        unsigned size = (j - i) / (test_jobs * 4);
+        if(size < 1) size = 1;
+        if(size > IHCT_BATCH_MAX) size = IHCT_BATCH_MAX;
+        for(unsigned k = i; k < j; k++) {
+            unit_batches[k] = (k - i) % size == 0 ? (j - k < size ? j - k : size) : 1;
+        }
+    }
+}
+
+// Runs a single unit on the calling worker thread. Cancellation is only enabled
+// while the unit itself runs, so the watchdog never cancels a worker inside the
+// runner (holding a lock).
+static void ihct_run_specific(unsigned i, ihct_record *record) {
+    ihct_test_result *result = &record->result;
+    ihct_probe probe;
+    ihct_probe_begin(&probe);
+
+    // Create a jump point, to be able to restore when encountering fatal signal.
+    // When returning here because of a fatal signal, we abort unit with status
+    // ERR. Has to be done inside of thread, refer to man setjmp:
+    // "If, in a multithreaded program, a longjmp() call employs an env
+    // buffer that was initialized by a call to setjmp() in a different
+    // thread, the behavior is undefined.".
+    int restore_status = sigsetjmp(restore_environment, 1);
+    if(restore_status != 0) {
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        restore_armed = false;
+
+        ihct_time_stop();
+        ihct_probe_end(&probe, &record->stats);
+        ihct_alloc_stop(&record->stats);
+        ihct_fixtures_crashed();
+        result->detail = ihct_property_crashed(property_seed);
+        char *p = malloc(strlen(strsignal(restore_status)) + 1);
+        strcpy(p, strsignal(restore_status));
+        result->code = p;
+        result->status = ERR;
+        return;
+    }
+    restore_armed = true;
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+
+    // Run test, and save it's result.
+    ihct_exec_unit(i, record);
+
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    restore_armed = false;
+    ihct_probe_end(&probe, &record->stats);
+}
+
+// Isolation. With --isolate, units are run in child processes instead of on the
+// worker threads. Children are forked by a zygote, a process forked off before
+// any worker is started, so every child starts from a clean single-threaded
+// copy of the program. A child runs units until it crashes or hangs, and only
+// then is replaced; the worker thread merely hands it units and waits for them.
+
+// Reply sent from a child for every unit run.
+struct ihct_child_reply {
+    int status;
+    int signal;
+    // Points to the code and file literals of the failing assert. These are
+    // valid in the parent as well, since the child is a fork of it.
+    char *code;
+    char *file;
+    unsigned long line;
+    ihct_unit_stats stats;
+    // Set for a benchmark, in which case its samples follow the reply.
+    bool has_bench;
+    ihct_bench_stats bench;
+    // Set for a concurrent unit, in which case the rates of its threads follow
+    // the samples.
+    bool has_concurrent;
+    ihct_concurrent_stats concurrent;
+    // Length of the detail of the result, following the samples, if any.
+    size_t detail_len;
+};
+
+// The parents end of the socket to the zygote, and the zygote itself.
+static int zygote_fd = -1;
+static pid_t zygote_pid;
+static pthread_mutex_t zygote_lock = PTHREAD_MUTEX_INITIALIZER;
+// The childs end of the socket to its worker.
+static int child_fd = -1;
+
+// Reads exactly n bytes, or returns false on end of file or error.
+static bool ihct_read_full(int fd, void *buf, size_t n) {
+    char *p = buf;
+    while(n) {
+        ssize_t r = read(fd, p, n);
+        if(r < 0 && errno == EINTR) continue;
+        if(r <= 0) return false;
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+// Writes exactly n bytes to a socket, without raising SIGPIPE if the other end
+// has died.
+static bool ihct_send_full(int fd, const void *buf, size_t n) {
+    const char *p = buf;
+    while(n) {
+        ssize_t r = send(fd, p, n, MSG_NOSIGNAL);
+        if(r < 0 && errno == EINTR) continue;
+        if(r <= 0) return false;
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+// Procedure called when a child receives a fatal signal. The state of the child
+// can't be trusted anymore, so it only reports the signal and exits.
+static void ihct_child_crash_proc(int sig) {
+    struct ihct_child_reply reply = {.status = ERR, .signal = sig};
+    (void)!write(child_fd, &reply, sizeof(reply));
+    _exit(128 + sig);
+}
+
+// Main loop of a child. Runs units by index until the worker hangs up.
+static void ihct_child_main(void) {
+    struct sigaction crash_action = {.sa_handler = &ihct_child_crash_proc};
+    sigemptyset(&crash_action.sa_mask);
+    sigaction(SIGSEGV, &crash_action, NULL);
+    sigaction(SIGTERM, &crash_action, NULL);
+    sigaction(SIGFPE, &crash_action, NULL);
+    sigaction(SIGILL, &crash_action, NULL);
+    sigaction(SIGABRT, &crash_action, NULL);
+    sigaction(SIGBUS, &crash_action, NULL);
+    signal(SIGCHLD, SIG_DFL);
+
+    unsigned i;
+    while(ihct_read_full(child_fd, &i, sizeof(i))) {
+        ihct_record record = {.result = {.status = PASS}};
+
+        ihct_probe probe;
+        ihct_probe_begin(&probe);
+        ihct_exec_unit(i, &record);
+        ihct_probe_end(&probe, &record.stats);
+        // Output of the test would otherwise be lost on _exit.
+        fflush(stdout);
+
+        ihct_test_result *result = &record.result;
+        struct ihct_child_reply reply = {.status = result->status, .code = result->code,
+            .file = result->file, .line = result->line, .stats = record.stats,
+            .has_bench = record.bench != NULL};
+        if(record.bench) reply.bench = *record.bench;
+        if(record.concurrent) {
+            reply.has_concurrent = true;
+            reply.concurrent = *record.concurrent;
+        }
+        if(result->detail) reply.detail_len = strlen(result->detail);
+        if(!ihct_send_full(child_fd, &reply, sizeof(reply))) break;
+        if(record.bench) {
+            if(!ihct_send_full(child_fd, record.bench->samples,
+                               record.bench->sample_count * sizeof(double))) break;
+            free(record.bench->samples);
+            free(record.bench);
+        }
+        if(record.concurrent) {
+            if(!ihct_send_full(child_fd, record.concurrent->rates,
+                               record.concurrent->threads * sizeof(double))) break;
+            free(record.concurrent->rates);
+            free(record.concurrent);
+        }
+        if(result->detail) {
+            if(!ihct_send_full(child_fd, result->detail, reply.detail_len)) break;
+            free(result->detail);
+        }
+    }
+    ihct_teardown_fixtures(true, 0);
+    _exit(0);
+}
+
+// Main loop of the zygote. Forks a new child for every byte received from the
+// parent, and passes the parent its end of a socket to the child.
+static void ihct_zygote_main(int fd) {
+    // Children are never waited on; let them be reaped automatically.
+    signal(SIGCHLD, SIG_IGN);
+
+    char c;
+    while(ihct_read_full(fd, &c, 1)) {
+        int sv[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) _exit(1);
+
+        pid_t pid = fork();
+        if(pid == 0) {
+            close(fd);
+            close(sv[0]);
+            child_fd = sv[1];
+            ihct_child_main();
+        }
+        close(sv[1]);
+
+        // Send the pid, along with the socket as ancillary data.
+        char control[CMSG_SPACE(sizeof(int))] = {0};
+        struct iovec iov = {&pid, sizeof(pid)};
+        struct msghdr msg = {
+            .msg_iov = &iov, .msg_iovlen = 1,
+            .msg_control = control, .msg_controllen = sizeof(control)
+        };
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &sv[0], sizeof(int));
+        if(sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) _exit(1);
+        close(sv[0]);
+    }
+    _exit(0);
+}
+
+// Forks the zygote. Has to be done before any other thread is started.
+static void ihct_start_zygote(void) {
+    int sv[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        printf("Couldn't create socket to zygote. Aborting.\n");
+        exit(EXIT_FAILURE);
+    }
+    // Buffered output would otherwise be written by every child as well.
+    fflush(stdout);
+
+    zygote_pid = fork();
+    if(zygote_pid < 0) {
+        printf("Couldn't fork zygote. Aborting.\n");
+        exit(EXIT_FAILURE);
+    }
+    if(zygote_pid == 0) {
+        close(sv[0]);
+        ihct_zygote_main(sv[1]);
+    }
+    close(sv[1]);
+    zygote_fd = sv[0];
+}
+
+static void ihct_stop_zygote(void) {
+    close(zygote_fd);
+    zygote_fd = -1;
+    waitpid(zygote_pid, NULL, 0);
+}
+
+// Requests a fresh child from the zygote for the worker.
+static bool ihct_spawn_child(ihct_worker *worker) {
+    pid_t pid;
+    int fd = -1;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = {&pid, sizeof(pid)};
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = control, .msg_controllen = sizeof(control)
+    };
+
+    pthread_mutex_lock(&zygote_lock);
+    bool ok = ihct_send_full(zygote_fd, "", 1) && recvmsg(zygote_fd, &msg, 0) == sizeof(pid);
+    pthread_mutex_unlock(&zygote_lock);
+
+    struct cmsghdr *cmsg = ok ? CMSG_FIRSTHDR(&msg) : NULL;
+    if(!cmsg || cmsg->cmsg_type != SCM_RIGHTS) return false;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+    pthread_mutex_lock(&worker->lock);
+    worker->child = pid;
+    worker->child_fd = fd;
+    pthread_mutex_unlock(&worker->lock);
+    return true;
+}
+
+// Throws away the workers child, after it has died or been killed.
+static void ihct_drop_child(ihct_worker *worker) {
+    pthread_mutex_lock(&worker->lock);
+    close(worker->child_fd);
+    worker->child_fd = -1;
+    worker->child = 0;
+    pthread_mutex_unlock(&worker->lock);
+}
+
+// Runs a single unit in the workers child, starting a child first if needed.
+static void ihct_run_isolated(ihct_worker *worker, unsigned i, ihct_record *record) {
+    ihct_test_result *result = &record->result;
+    bool spawned = worker->child_fd >= 0 || ihct_spawn_child(worker);
+    // The unit may have timed out while its child was being spawned, before
+    // there was a child to kill.
+    pthread_mutex_lock(&worker->lock);
+    bool late = worker->killed;
+    worker->killed = false;
+    pthread_mutex_unlock(&worker->lock);
+    if(!spawned) {
+        result->status = ERR;
+        result->code = strdup("couldn't start child process");
+        return;
+    }
+    if(late) {
+        kill(worker->child, SIGKILL);
+        ihct_drop_child(worker);
+        result->status = TIMEOUT;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        record->stats.wall = timespec_since(&worker->started, &now);
+        return;
+    }
+
+    struct ihct_child_reply reply;
+    bool replied = ihct_send_full(worker->child_fd, &i, sizeof(i)) &&
+                   ihct_read_full(worker->child_fd, &reply, sizeof(reply));
+    if(replied && reply.has_bench) {
+        ihct_bench_stats *bench = malloc(sizeof(*bench));
+        if(bench) {
+            *bench = reply.bench;
+            bench->samples = malloc(bench->sample_count * sizeof(double));
+        }
+        if(!bench || !bench->samples) {
+            printf("Couldn't allocate memory for benchmark samples.\n");
+            exit(EXIT_FAILURE);
+        }
+        record->bench = bench;
+        replied = ihct_read_full(worker->child_fd, bench->samples,
+                                 bench->sample_count * sizeof(double));
+    }
+    if(replied && reply.has_concurrent) {
+        ihct_concurrent_stats *concurrent = malloc(sizeof(*concurrent));
+        if(concurrent) {
+            *concurrent = reply.concurrent;
+            concurrent->rates = malloc(concurrent->threads * sizeof(double));
+        }
+        if(!concurrent || !concurrent->rates) {
+            printf("Couldn't allocate memory for threads.\n");
+            exit(EXIT_FAILURE);
+        }
+        record->concurrent = concurrent;
+        replied = ihct_read_full(worker->child_fd, concurrent->rates,
+                                 concurrent->threads * sizeof(double));
+    }
+    if(replied && reply.detail_len) {
+        result->detail = malloc(reply.detail_len + 1);
+        if(!result->detail) {
+            printf("Couldn't allocate memory for result detail.\n");
+            exit(EXIT_FAILURE);
+        }
+        replied = ihct_read_full(worker->child_fd, result->detail, reply.detail_len);
+        result->detail[reply.detail_len] = '\0';
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    bool killed = worker->killed;
+    worker->killed = false;
+    pthread_mutex_unlock(&worker->lock);
+
+    if(replied) {
+        record->stats = reply.stats;
+        result->status = reply.status;
+        result->code = reply.code;
+        result->file = reply.file;
+        result->line = reply.line;
+        if(reply.status == ERR) result->code = strdup(strsignal(reply.signal));
+    } else if(killed) {
+        result->status = TIMEOUT;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        record->stats.wall = timespec_since(&worker->started, &now);
+    } else {
+        // Died without being able to report why.
+        result->status = ERR;
+        result->code = strdup("child process died");
+    }
+
+    if(!replied || killed || reply.status == ERR) ihct_drop_child(worker);
+}
+
+// Starts a thread of the runner. Without one of them, units would be left
+// never run, and the run never done.
+static void ihct_start_thread(pthread_t *tid, void *(*routine)(void *), void *arg) {
+    if(pthread_create(tid, NULL, routine, arg) != 0) {
+        printf("Couldn't start thread. Aborting.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Routine run by every worker thread. Picks up units until there are none left,
+// and hands each result to the collecting thread.
+static void *routine_worker(void *arg) {
+    ihct_worker *worker = (ihct_worker *)arg;
+
+    // The thread may only be canceled (by the watchdog) while running a unit,
+    // and then has to be canceled right away; the unit might never yield.
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+
+    // A thread replacing one given up on goes on with the rest of its batch.
+    pthread_mutex_lock(&worker->lock);
+    unsigned generation = worker->generation;
+    unsigned next = worker->current + 1, end = worker->batch_end;
+    pthread_mutex_unlock(&worker->lock);
+
+    for(;;) {
+        struct timespec started;
+        clock_gettime(CLOCK_MONOTONIC, &started);
+        if(suite_timeout > 0 && timespec_cmp(&started, &suite_deadline) >= 0) {
+            pthread_mutex_lock(&result_lock);
+            suite_deadline_reached = true;
+            ihct_stop_scheduling();
+            pthread_mutex_unlock(&result_lock);
+            // The rest of the batch was already taken, so is never run.
+            for(; next < end; next++) {
+                ihct_record *p = calloc(1, sizeof(*p));
+                p->skipped = true;
+                ihct_publish_record(next, p);
+            }
+            break;
+        }
+
+        unsigned i;
+        if(next < end) {
+            i = next++;
+        } else {
+            i = __atomic_load_n(&next_unit, __ATOMIC_RELAXED);
+            while(i < slot_count && !__atomic_compare_exchange_n(&next_unit, &i,
+                  i + unit_batches[i % unit_count], true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+            if(i >= slot_count) break;
+            next = i + 1;
+            end = i + unit_batches[i % unit_count];
+        }
+        unsigned u = i % unit_count;
+
+        if(unit_cached && unit_cached[u]) {
+            ihct_record *p = calloc(1, sizeof(*p));
+            p->cached = true;
+            ihct_publish_record(i, p);
+            continue;
+        }
+
+        // The record lives on this threads stack until it is published; a thread
+        // given up on by the watchdog may still write to it while dying.
+        ihct_record record = {.result = {.status = PASS}};
+
+        // Set a limited time the unit may be run, which never goes past the end
+        // of the whole run.
+        struct timespec deadline = started;
+        bool timed = unit_timeouts[u] > 0;
+        if(timed) timespec_add_ms(&deadline, unit_timeouts[u]);
+        if(suite_timeout > 0 && (!timed || timespec_cmp(&suite_deadline, &deadline) < 0)) {
+            deadline = suite_deadline;
+            timed = true;
+        }
+
+        pthread_mutex_lock(&worker->lock);
+        worker->running = true;
+        worker->current = i;
+        worker->batch_end = end;
+        worker->started = started;
+        worker->timed = timed;
+        worker->deadline = deadline;
+        pthread_mutex_unlock(&worker->lock);
+
+        pthread_mutex_lock(&watchdog_lock);
+        if(timed && watchdog_sleeping && (!watchdog_has_next ||
+           timespec_cmp(&deadline, &watchdog_next) < 0)) {
+            pthread_cond_signal(&watchdog_wake);
+        }
+        pthread_mutex_unlock(&watchdog_lock);
+
+        if(test_isolate) ihct_run_isolated(worker, u, &record);
+        else ihct_run_specific(u, &record);
+
+        // If the watchdog timed the unit out meanwhile, it has already reported
+        // it and replaced this thread.
+        pthread_mutex_lock(&worker->lock);
+        bool replaced = worker->generation != generation;
+        worker->running = false;
+        pthread_mutex_unlock(&worker->lock);
+        if(replaced) {
+            ihct_record_clear(&record);
+            return NULL;
+        }
+
+        ihct_record *p = malloc(sizeof(*p));
+        *p = record;
+        ihct_publish_record(i, p);
+    }
+    return NULL;
+}
+
+// Times out a worker whose unit has passed its deadline. The hung thread is
+// canceled and left behind; a fresh thread takes over the worker. Note that the
+// canceled thread may still leak whatever the unit had allocated. An isolated
+// unit is instead killed along with its child, and reported by the worker.
+static void ihct_timeout_worker(ihct_worker *worker) {
+    if(test_isolate) {
+        // Without a child yet, the worker times the unit out once it has one;
+        // a pid of 0 would kill the whole process group.
+        if(worker->child > 0) kill(worker->child, SIGKILL);
+        worker->killed = true;
+        worker->running = false;
+        return;
+    }
+
+    pthread_cancel(worker->tid);
+    pthread_detach(worker->tid);
+    worker->running = false;
+    worker->generation++;
+
+    ihct_record *record = calloc(1, sizeof(*record));
+    record->result.status = TIMEOUT;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    record->stats.wall = timespec_since(&worker->started, &now);
+    ihct_publish_record(worker->current, record);
+
+    ihct_start_thread(&worker->tid, routine_worker, worker);
+}
+
+// Routine of the watchdog thread. Times out units that have run past their
+// deadline, and otherwise sleeps until the next deadline.
+static void *routine_watchdog(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&watchdog_lock);
+    while(!watchdog_stop) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        bool any = false;
+        struct timespec next = {0};
+        for(long w = 0; w < test_jobs; w++) {
+            ihct_worker *worker = &workers[w];
+            pthread_mutex_lock(&worker->lock);
+            if(worker->running && worker->timed) {
+                if(timespec_cmp(&worker->deadline, &now) <= 0) {
+                    ihct_timeout_worker(worker);
+                } else if(!any || timespec_cmp(&worker->deadline, &next) < 0) {
+                    next = worker->deadline;
+                    any = true;
+                }
+            }
+            pthread_mutex_unlock(&worker->lock);
+        }
+
+        watchdog_sleeping = true;
+        watchdog_has_next = any;
+        watchdog_next = next;
+        // With nothing running, sleep until any unit starts.
+        if(any) pthread_cond_timedwait(&watchdog_wake, &watchdog_lock, &next);
+        else pthread_cond_wait(&watchdog_wake, &watchdog_lock);
+        watchdog_sleeping = false;
+    }
+    pthread_mutex_unlock(&watchdog_lock);
+    return NULL;
+}
+
+// Sharding. A unit is put in the same shard on every runner, and in every run
+// with the same timings. Without timings, units are spread by a hash of their
+// name. With timings, they are packed into shards longest first, each into the
+// shard with the least total duration so far, so that all shards take about as
+// long to run.
+
+// 32-bit FNV-1a hash of a string.
+static unsigned long ihct_name_hash(const char *s) {
+    unsigned long h = 2166136261u;
+    for(; *s; s++) {
+        h ^= (unsigned char)*s;
+        h = (h * 16777619u) & 0xffffffffu;
+    }
+    return h;
+}
+
+// A unit to pack into a shard, and its expected duration.
+typedef struct {
+    unsigned index;
+    double duration;
+} ihct_shard_item;
+
+static int ihct_shard_item_cmp(const void *a, const void *b) {
+    const ihct_shard_item *x = a, *y = b;
+    if(x->duration != y->duration) return (x->duration < y->duration) - (x->duration > y->duration);
+    int c = strcmp(units[x->index]->name, units[y->index]->name);
+    if(c) return c;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Assigns every unit a shard in keep, by packing the units longest first.
+static void ihct_shard_by_timings(const ihct_baseline *timings, bool *keep) {
+    ihct_shard_item *items = malloc(unit_count * sizeof(*items));
+    double *loads = calloc(shard_count, sizeof(*loads));
+    if(!items || !loads) {
+        printf("Couldn't allocate memory for sharding.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Units without a timing (new ones) are expected to take the mean duration.
+    double known = 0;
+    unsigned known_count = 0;
+    for(unsigned i = 0; i < unit_count; i++) {
+        const ihct_baseline_entry *e = ihct_baseline_find(timings, units[i]->name);
+        items[i].index = i;
+        items[i].duration = -1;
+        if(e && e->sample_count) {
+            items[i].duration = e->samples[0];
+            known += e->samples[0];
+            known_count++;
+        }
+    }
+    double mean = known_count ? known / known_count : 0;
+    for(unsigned i = 0; i < unit_count; i++) {
+        if(items[i].duration < 0) items[i].duration = mean;
+    }
+    qsort(items, unit_count, sizeof(*items), ihct_shard_item_cmp);
+
+    for(unsigned i = 0; i < unit_count; i++) {
+        long lightest = 0;
+        for(long s = 1; s < shard_count; s++) {
+            if(loads[s] < loads[lightest]) lightest = s;
+        }
+        loads[lightest] += items[i].duration;
+        keep[items[i].index] = lightest == shard_index - 1;
+    }
+    free(loads);
+    free(items);
+}
+
+// Removes every unit not in the shard to run, keeping the order of the rest.
+static void ihct_shard_units(void) {
+    if(shard_count <= 1 || !unit_count) return;
+
+    bool *keep = malloc(unit_count * sizeof(*keep));
+    if(!keep) {
+        printf("Couldn't allocate memory for sharding.\n");
+        exit(EXIT_FAILURE);
+    }
+    ihct_baseline timings = {0};
+    if(timings_path && !ihct_baseline_load(&timings, timings_path)) {
+        printf("couldn't read timings '%s', sharding by name.\n", timings_path);
+    }
+    if(timings.count) {
+        ihct_shard_by_timings(&timings, keep);
+    } else {
+        for(unsigned i = 0; i < unit_count; i++) {
+            keep[i] = ihct_name_hash(units[i]->name) % shard_count == (unsigned long)shard_index - 1;
+        }
+    }
+    ihct_baseline_free(&timings);
+
+    unsigned n = 0;
+    for(unsigned i = 0; i < unit_count; i++) {
+        if(keep[i]) units[n++] = units[i];
+    }
+    unit_count = n;
+    free(keep);
+}
+
+// Prints the selected units in the order they would run, one per line: the
+// name, where the unit is defined, and its tags.
+static void ihct_list_units(void) {
+    for(unsigned i = 0; i < unit_count; i++) {
+        const ihct_unit *u = units[i];
+        ihct_strbuf_appendf(&progress, "%s %s:%lu", u->name, u->file ? u->file : "?", u->line);
+        for(size_t k = 0; u->tags && u->tags[k]; k++) {
+            ihct_strbuf_appendf(&progress, " @%s", u->tags[k]);
+        }
+        ihct_strbuf_append(&progress, "\n");
+    }
+    ihct_strbuf_flush(&progress, stdout);
+}
+
+// Incremental runs. Every unit is fingerprinted, and skipped if it passed with
+// the same fingerprint before. Units without a fingerprint always run.
+static void ihct_fingerprint_units(void) {
+    unit_fingerprints = calloc(unit_count ? unit_count : 1, sizeof(*unit_fingerprints));
+    unit_cached = calloc(unit_count ? unit_count : 1, sizeof(*unit_cached));
+    if(!unit_fingerprints || !unit_cached) {
+        printf("Couldn't allocate memory for fingerprints.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ihct_cache cache;
+    if(!ihct_cache_load(&cache, cache_path)) {
+        printf("couldn't read cache '%s', running every unit.\n", cache_path);
+    }
+    for(unsigned i = 0; i < unit_count; i++) {
+        const ihct_unit *u = units[i];
+        const void *proc = ihct_unit_code(u);
+        uint64_t cached;
+        if(!ihct_fingerprint_unit(proc, u->deps, &unit_fingerprints[i])) continue;
+        // The row of a parameterized test is a part of it as well.
+        if(u->kind == IHCT_UNIT_PARAM) {
+            ihct_fingerprint_data(&unit_fingerprints[i], (const char *)u->params +
+                                  u->param_index * u->param_size, u->param_size);
+        }
+        // So are the inputs a property is checked for, which are new with every
+        // seed (and every run without one), and more with more cases.
+        if(u->kind == IHCT_UNIT_PROPERTY) {
+            ihct_fingerprint_data(&unit_fingerprints[i], &property_seed, sizeof(property_seed));
+            ihct_fingerprint_data(&unit_fingerprints[i], &property_cases, sizeof(property_cases));
+        }
+        unit_cached[i] = !cache_ignored &&
+            ihct_cache_get(&cache, ihct_history_hash(u->name), &cached) &&
+            cached == unit_fingerprints[i];
+    }
+    ihct_cache_free(&cache);
+    ihct_fingerprint_free();
+}
+
+// Remembers the fingerprints of the units that passed, and forgets those of
+// the units that didn't.
+static void ihct_save_cache(void) {
+    ihct_cache_entry *updates = malloc((unit_count ? unit_count : 1) * sizeof(*updates));
+    if(!updates) {
+        printf("Couldn't allocate memory for cache.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t n = 0;
+    for(unsigned i = 0; i < unit_count; i++) {
+        if(!unit_ran[i]) continue;
+        uint64_t fingerprint = unit_status[i] == PASS ? unit_fingerprints[i] : 0;
+        updates[n++] = (ihct_cache_entry){ihct_history_hash(units[i]->name), fingerprint};
+    }
+
+    // Units of other shards, or other binaries, sharing the cache are kept.
+    ihct_cache cache;
+    if(ihct_cache_load(&cache, cache_path)) {
+        ihct_cache_update(&cache, updates, n);
+        if(!ihct_cache_save(&cache, cache_path)) {
+            ihct_strbuf_appendf(&progress, "couldn't write cache '%s'.\n", cache_path);
+        }
+    }
+    ihct_cache_free(&cache);
+    free(updates);
+}
+
+// Ordering. Units that failed in one of the last IHCT_HISTORY_WINDOW runs come
+// first with failed-first, the most recent failures first. Units are sorted by
+// their mean recent duration with fastest-first; new units count as instant.
+
+// A unit to order, and what the history tells about it.
+typedef struct {
+    const ihct_unit *unit;
+    unsigned index;
+    unsigned failed;
+    double wall;
+} ihct_order_item;
+
+static int ihct_order_item_cmp(const void *a, const void *b) {
+    const ihct_order_item *x = a, *y = b;
+    for(int k = 0; k < order_key_count; k++) {
+        switch(order_keys[k]) {
+        case IHCT_ORDER_FAILED_FIRST:
+            if(x->failed != y->failed) return x->failed < y->failed ? 1 : -1;
+            break;
+        case IHCT_ORDER_FASTEST_FIRST:
+            if(x->wall != y->wall) return x->wall < y->wall ? -1 : 1;
+            break;
+        }
+    }
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Parses a comma separated list of order keys. Returns false on an unknown key.
+static bool ihct_parse_order(const char *arg) {
+    order_key_count = 0;
+    const char *p = arg;
+    while(*p) {
+        size_t len = strcspn(p, ",");
+        if(order_key_count == IHCT_ORDER_MAX_KEYS) return false;
+        if(len == strlen("failed-first") && !strncmp(p, "failed-first", len)) {
+            order_keys[order_key_count++] = IHCT_ORDER_FAILED_FIRST;
+        } else if(len == strlen("fastest-first") && !strncmp(p, "fastest-first", len)) {
+            order_keys[order_key_count++] = IHCT_ORDER_FASTEST_FIRST;
+        } else if(len) {
+            return false;
+        }
+        p += len;
+        if(*p) p++;
+    }
+    return true;
+}
+
+// Sorts the units by the order keys, keeping the defined order between equals.
+static void ihct_order_units(void) {
+    if(!order_key_count || !unit_count) return;
+
+    ihct_order_item *items = malloc(unit_count * sizeof(*items));
+    if(!items) {
+        printf("Couldn't allocate memory for ordering.\n");
+        exit(EXIT_FAILURE);
+    }
+    unsigned recent = history.run_count > IHCT_HISTORY_WINDOW ?
+        history.run_count - IHCT_HISTORY_WINDOW : 0;
+    for(unsigned i = 0; i < unit_count; i++) {
+        const ihct_history_unit *h = ihct_history_find(&history,
+                                                       ihct_history_hash(units[i]->name));
+        items[i] = (ihct_order_item){units[i], i, 0, 0};
+        if(h) {
+            items[i].failed = h->failed > recent ? h->failed : 0;
+            items[i].wall = ihct_history_mean_wall(h);
+        }
+    }
+    qsort(items, unit_count, sizeof(*items), ihct_order_item_cmp);
+    for(unsigned i = 0; i < unit_count; i++) units[i] = items[i].unit;
+    free(items);
+}
+
+// Appends the result of every unit that was run to the history.
+static void ihct_save_history(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t run = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+    ihct_history_record *out = malloc((unit_count ? unit_count : 1) * sizeof(*out));
+    if(!out) {
+        printf("Couldn't allocate memory for the history.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t n = 0;
+    for(unsigned i = 0; i < unit_count; i++) {
+        if(!unit_ran[i]) continue;
+        out[n++] = (ihct_history_record){run, ihct_history_hash(units[i]->name),
+                                         unit_stats[i].wall, unit_status[i], 0};
+    }
+    if(!ihct_history_append(history_path, out, n)) {
+        ihct_strbuf_appendf(&progress, "couldn't write history '%s'.\n", history_path);
+    }
+    free(out);
+}
+
+// Prints the recent durations and failures of every unit in the history.
+static void ihct_print_history_report(int name_width) {
+    static const char *status_names[] = {"pass", "fail", "fail", "error", "timeout",
+                                         "regression"};
+    ihct_strbuf_appendf(&progress, IHCT_BOLD "%-*s %6s %6s %-10s %10s %10s %8s" IHCT_RESET "\n",
+        name_width, "unit", "runs", "fails", "last", "mean ms", "last ms", "trend");
+    for(unsigned i = 0; i < unit_count; i++) {
+        const ihct_history_unit *h = ihct_history_find(&history,
+                                                       ihct_history_hash(units[i]->name));
+        if(!h) {
+            ihct_strbuf_appendf(&progress, "%-*s %6u\n", name_width, units[i]->name, 0);
+            continue;
+        }
+        // The trend is the last duration against the mean of those before it.
+        double last = h->walls[h->wall_count - 1];
+        double before = 0;
+        for(unsigned k = 0; k + 1 < h->wall_count; k++) before += h->walls[k];
+        ihct_strbuf_appendf(&progress, "%-*s %6u %6u %-10s %10.3f %10.3f", name_width,
+            units[i]->name, h->runs, h->failures,
+            h->last_status < sizeof(status_names) / sizeof(*status_names) ?
+                status_names[h->last_status] : "?",
+            ihct_history_mean_wall(h) * 1e3, last * 1e3);
+        if(h->wall_count > 1 && before > 0) {
+            before /= h->wall_count - 1;
+            ihct_strbuf_appendf(&progress, " %+7.1f%%\n", (last / before - 1) * 100);
+        } else {
+            ihct_strbuf_appendf(&progress, " %8s\n", "-");
+        }
+    }
+    ihct_strbuf_flush(&progress, stdout);
+}
+
+static int ihct_unit_cmp_wall(const void *a, const void *b) {
+    double wa = unit_stats[*(const unsigned *)a].wall;
+    double wb = unit_stats[*(const unsigned *)b].wall;
+    return (wa < wb) - (wa > wb);
+}
+
+// Saves the wall time of every unit run, in seconds. The timings of all shards
+// can be concatenated, and given back to --timings.
+static void ihct_save_timings(void) {
+    ihct_strbuf out;
+    ihct_strbuf_init(&out);
+    for(unsigned i = 0; i < unit_count; i++) {
+        // Units not run would count as taking no time at all.
+        if(!unit_ran[i]) continue;
+        // Run over and over, a unit takes its median time rather than its last.
+        double wall = unit_flaky ? ihct_flaky_quantile(&unit_flaky[i], 0.5) : unit_stats[i].wall;
+        ihct_baseline_append(&out, units[i]->name, &wall, 1);
+    }
+
+    FILE *f = fopen(timings_save_path, "w");
+    if(f) {
+        ihct_strbuf_flush(&out, f);
+        fclose(f);
+    } else {
+        ihct_strbuf_appendf(&progress, "couldn't write timings '%s'.\n", timings_save_path);
+    }
+    ihct_strbuf_free(&out);
+}
+
+// Adds a note of the blocks a unit leaked to the summary.
+static void ihct_add_leak_to_summary(const ihct_alloc_stats *allocs, const ihct_unit *unit) {
+    if(!text_output) return;
+    ihct_strbuf_appendf(&summary, "unit '"
+        IHCT_BOLD "%s"
+        IHCT_RESET "' "
+        IHCT_FG_MAGENTA "leaked "
+        IHCT_RESET "%lu blocks (%llu bytes).\n", unit->name, allocs->leaked,
+        allocs->leaked_bytes);
+}
+
+// Adds a table of the test_slowest units, by wall time, to the progress output.
+static void ihct_add_slowest_to_report(int name_width) {
+    if(!unit_count) return;
+    unsigned *order = malloc(unit_count * sizeof(unsigned));
+    if(!order) {
+        printf("Couldn't allocate memory for the slowest units.\n");
+        exit(EXIT_FAILURE);
+    }
+    unsigned ran = 0;
+    for(unsigned i = 0; i < unit_count; i++) {
+        if(unit_ran[i]) order[ran++] = i;
+    }
+    qsort(order, ran, sizeof(unsigned), &ihct_unit_cmp_wall);
+
+    unsigned n = (unsigned long)test_slowest < ran ? test_slowest : ran;
+    ihct_strbuf_appendf(&progress, IHCT_BOLD "slowest %u:\n%-*s %10s %10s %10s %8s %8s %8s",
+        n, name_width, "unit", "wall ms", "cpu ms", "rss kB", "faults", "csw", "icsw");
+    if(test_counters) {
+        for(int e = 0; e < IHCT_COUNTER_COUNT; e++) {
+            ihct_strbuf_appendf(&progress, " %14s", ihct_counters_name(e));
+        }
+    }
+    if(alloc_hooks.begin) ihct_strbuf_appendf(&progress, " %8s %12s", "allocs", "alloc bytes");
+    ihct_strbuf_append(&progress, IHCT_RESET "\n");
+    for(unsigned k = 0; k < n; k++) {
+        const ihct_unit_stats *s = &unit_stats[order[k]];
+        ihct_strbuf_appendf(&progress, "%-*s %10.3f %10.3f %10ld %8ld %8ld %8ld",
+            name_width, units[order[k]]->name, s->wall * 1e3, s->cpu * 1e3, s->maxrss,
+            s->minflt + s->majflt, s->nvcsw, s->nivcsw);
+        // Events that couldn't be counted are left blank.
+        for(int e = 0; test_counters && e < IHCT_COUNTER_COUNT; e++) {
+            if(s->counters.available & 1u << e) {
+                ihct_strbuf_appendf(&progress, " %14llu", (unsigned long long)s->counters.values[e]);
+            } else {
+                ihct_strbuf_appendf(&progress, " %14s", "-");
+            }
+        }
+        if(alloc_hooks.begin) {
+            ihct_strbuf_appendf(&progress, " %8lu %12llu", s->allocs.allocs, s->allocs.bytes);
+        }
+        ihct_strbuf_append(&progress, "\n");
+    }
+    ihct_strbuf_append(&progress, "\n");
+    free(order);
+}
+
+// Adds a way a unit failed, as a line below it, to the progress output.
+static void ihct_add_flaky_location(const ihct_flaky_location *l) {
+    ihct_strbuf_appendf(&progress, "    %6u x ", l->count);
+    switch(l->status) {
+    case FAIL:
+        ihct_strbuf_appendf(&progress, "%s:%lu: '%s'\n", l->file, l->line, l->code);
+        break;
+    case FAIL_FORCE:
+        ihct_strbuf_appendf(&progress, "%s:%lu: forcefully failed\n", l->file, l->line);
+        break;
+    case ERR:
+        ihct_strbuf_appendf(&progress, "fatal signal (%s)\n", l->code);
+        break;
+    case TIMEOUT:
+        ihct_strbuf_append(&progress, "timed out\n");
+        break;
+    case REGRESSION:
+        ihct_strbuf_append(&progress, "regressed\n");
+        break;
+    }
+}
+
+// Adds the units that both passed and failed when run over and over to the
+// progress output. With --flaky-report, adds a table of how every unit did.
+static void ihct_add_flaky_to_report(int name_width) {
+    if(flaky_report) {
+        ihct_strbuf_appendf(&progress, IHCT_BOLD "%-*s %8s %8s %10s %10s %10s %10s %10s"
+            IHCT_RESET "\n", name_width, "unit", "runs", "failed", "pass rate", "min ms",
+            "median ms", "p99 ms", "max ms");
+    }
+    unsigned flaky_count = 0;
+    for(unsigned i = 0; i < unit_count; i++) {
+        const ihct_flaky *f = &unit_flaky[i];
+        bool flaky = ihct_flaky_is_flaky(f);
+        flaky_count += flaky;
+        if(!flaky_report || !f->runs) continue;
+        ihct_strbuf_appendf(&progress, "%-*s %8u %8u %9.2f%% %10.3f %10.3f %10.3f %10.3f%s\n",
+            name_width, units[i]->name, f->runs, f->failures,
+            100.0 * (f->runs - f->failures) / f->runs, f->wall_min * 1e3,
+            ihct_flaky_quantile(f, 0.5) * 1e3, ihct_flaky_quantile(f, 0.99) * 1e3,
+            f->wall_max * 1e3, flaky ? IHCT_FG_YELLOW "  flaky" IHCT_RESET : "");
+        for(unsigned k = 0; k < f->location_count; k++) {
+            ihct_add_flaky_location(&f->locations[k]);
+        }
+        if(f->other_failures) {
+            ihct_strbuf_appendf(&progress, "    %6u x elsewhere\n", f->other_failures);
+        }
+    }
+    if(flaky_report) ihct_strbuf_append(&progress, "\n");
+    if(!flaky_count) return;
+
+    ihct_strbuf_appendf(&progress, IHCT_FG_YELLOW "%u flaky " IHCT_RESET
+        "(both passed and failed):\n", flaky_count);
+    for(unsigned i = 0; i < unit_count; i++) {
+        const ihct_flaky *f = &unit_flaky[i];
+        if(!ihct_flaky_is_flaky(f)) continue;
+        ihct_strbuf_appendf(&progress, "    %-*s failed %u of %u runs\n", name_width,
+            units[i]->name, f->failures, f->runs);
+    }
+    ihct_strbuf_append(&progress, "\n");
+}
+
+// How many times over the unit list is run in a round: enough for every worker
+// to be kept busy, but not past the given number of runs left, if any.
+static unsigned ihct_round_copies(unsigned long left) {
+    unsigned long want = (unsigned long)test_jobs * 4;
+    if(want < IHCT_ROUND_SLOTS) want = IHCT_ROUND_SLOTS;
+    unsigned long copies = unit_count ? (want + unit_count - 1) / unit_count : 1;
+    if(left && copies > left) copies = left;
+    return copies;
+}
+
+int ihct_run(int argc, char **argv) {
+    unsigned failed_count = 0;
+    unsigned leaked_count = 0;
+    unsigned skipped_count = 0;
+    unsigned cached_count = 0;
+
+    // initialize the summary and progress line
+    ihct_strbuf_init(&summary);
+    ihct_strbuf_init(&progress);
+
+    // handle args, starting over from the defaults and the first argument.
+    ihct_default_options();
+    optind = 0;
+    enum {OPT_ISOLATE = 256, OPT_BENCH_TIME, OPT_BENCH_SAMPLES, OPT_SAVE_BASELINE,
+          OPT_COMPARE_BASELINE, OPT_REGRESSION_THRESHOLD, OPT_SLOWEST, OPT_COUNTERS,
+          OPT_SHARD, OPT_TIMINGS, OPT_SAVE_TIMINGS, OPT_HISTORY, OPT_HISTORY_REPORT,
+          OPT_ORDER, OPT_FAIL_FAST, OPT_MAX_FAILURES, OPT_INCREMENTAL, OPT_NO_CACHE,
+          OPT_CACHE, OPT_EXCLUDE, OPT_LIST, OPT_DEADLINE, OPT_CASES, OPT_SEED,
+          OPT_REPORTER, OPT_OUTPUT, OPT_REPEAT, OPT_UNTIL_FAIL, OPT_FLAKY_REPORT};
+    static struct option long_options[] = {
+        {"isolate", no_argument, NULL, OPT_ISOLATE},
+        {"bench", no_argument, NULL, 'b'},
+        {"bench-time", required_argument, NULL, OPT_BENCH_TIME},
+        {"bench-samples", required_argument, NULL, OPT_BENCH_SAMPLES},
+        {"save-baseline", required_argument, NULL, OPT_SAVE_BASELINE},
+        {"compare-baseline", required_argument, NULL, OPT_COMPARE_BASELINE},
+        {"regression-threshold", required_argument, NULL, OPT_REGRESSION_THRESHOLD},
+        {"slowest", required_argument, NULL, OPT_SLOWEST},
+        {"counters", no_argument, NULL, OPT_COUNTERS},
+        {"shard", required_argument, NULL, OPT_SHARD},
+        {"timings", required_argument, NULL, OPT_TIMINGS},
+        {"save-timings", required_argument, NULL, OPT_SAVE_TIMINGS},
+        {"history", required_argument, NULL, OPT_HISTORY},
+        {"history-report", no_argument, NULL, OPT_HISTORY_REPORT},
+        {"order", required_argument, NULL, OPT_ORDER},
+        {"fail-fast", no_argument, NULL, OPT_FAIL_FAST},
+        {"max-failures", required_argument, NULL, OPT_MAX_FAILURES},
+        {"incremental", no_argument, NULL, OPT_INCREMENTAL},
+        {"no-cache", no_argument, NULL, OPT_NO_CACHE},
+        {"cache", required_argument, NULL, OPT_CACHE},
+        {"filter", required_argument, NULL, 'f'},
+        {"exclude", required_argument, NULL, OPT_EXCLUDE},
+        {"list", no_argument, NULL, OPT_LIST},
+        {"timeout", required_argument, NULL, 't'},
+        {"deadline", required_argument, NULL, OPT_DEADLINE},
+        {"cases", required_argument, NULL, OPT_CASES},
+        {"seed", required_argument, NULL, OPT_SEED},
+        {"reporter", required_argument, NULL, OPT_REPORTER},
+        {"output", required_argument, NULL, OPT_OUTPUT},
+        {"repeat", required_argument, NULL, OPT_REPEAT},
+        {"until-fail", no_argument, NULL, OPT_UNTIL_FAIL},
+        {"flaky-report", no_argument, NULL, OPT_FLAKY_REPORT},
+        {0}
+    };
+    bool repeat_set = false;
+    int c;
+    while((c = getopt_long(argc, argv, "t:j:bf:", long_options, NULL)) != -1) {
+        switch(c) {
+        case OPT_ISOLATE:
+            test_isolate = true;
+            break;
+        case 'b':
+            test_bench = true;
+            break;
+        case OPT_BENCH_TIME:
+            bench_time = atol(optarg);
+            if(bench_time <= 0) bench_time = 1;
+            break;
+        case OPT_BENCH_SAMPLES:
+            bench_samples = atol(optarg);
+            if(bench_samples <= 0) bench_samples = 1;
+            break;
+        case OPT_SAVE_BASELINE:
+            bench_save_path = optarg;
+            break;
+        case OPT_COMPARE_BASELINE:
+            bench_compare_path = optarg;
+            break;
+        case OPT_REGRESSION_THRESHOLD:
+            bench_threshold = atof(optarg);
+            break;
+        case OPT_SLOWEST:
+            test_slowest = atol(optarg);
+            break;
+        case OPT_COUNTERS:
+            test_counters = true;
+            break;
+        case OPT_SHARD:
+            if(sscanf(optarg, "%ld/%ld", &shard_index, &shard_count) != 2 ||
+               shard_count < 1 || shard_index < 1 || shard_index > shard_count) {
+                printf("invalid shard '%s', expected i/N with 1 <= i <= N.\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_TIMINGS:
+            timings_path = optarg;
+            break;
+        case OPT_SAVE_TIMINGS:
+            timings_save_path = optarg;
+            break;
+        case OPT_HISTORY:
+            history_path = optarg;
+            break;
+        case OPT_HISTORY_REPORT:
+            history_report = true;
+            break;
+        case OPT_ORDER:
+            if(!ihct_parse_order(optarg)) {
+                printf("invalid order '%s', expected a list of failed-first and fastest-first.\n",
+                       optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_FAIL_FAST:
+            max_failures = 1;
+            break;
+        case OPT_MAX_FAILURES:
+            max_failures = atol(optarg);
+            break;
+        case OPT_INCREMENTAL:
+            test_incremental = true;
+            break;
+        case OPT_NO_CACHE:
+            cache_ignored = true;
+            break;
+        case OPT_CACHE:
+            cache_path = optarg;
+            break;
+        case 'f':
+        case OPT_EXCLUDE: {
+            bool exclude = c == OPT_EXCLUDE || optarg[0] == '!';
+            const char *pattern = c == 'f' && optarg[0] == '!' ? optarg + 1 : optarg;
+            if(!ihct_filters_add(&filters, pattern, exclude)) {
+                printf("invalid filter '%s'.\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        }
+        case OPT_LIST:
+            test_list = true;
+            break;
+        case 't':
+            if(!ihct_parse_duration(optarg, &test_timeout)) {
+                printf("invalid timeout '%s', expected a duration such as 500ms or 2s.\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_DEADLINE:
+            if(!ihct_parse_duration(optarg, &suite_timeout)) {
+                printf("invalid deadline '%s', expected a duration such as 500ms or 2s.\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_CASES:
+            property_cases = atol(optarg);
+            if(property_cases <= 0) property_cases = 1;
+            break;
+        case OPT_REPORTER:
+            reporter = ihct_reporter_find(optarg);
+            if(!reporter) {
+                printf("unknown reporter '%s', expected one of %s.\n", optarg,
+                       ihct_reporter_names);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_OUTPUT:
+            report_path = optarg;
+            break;
+        case OPT_REPEAT:
+            test_repeat = atol(optarg);
+            if(test_repeat <= 0) test_repeat = 1;
+            repeat_set = true;
+            break;
+        case OPT_UNTIL_FAIL:
+            until_fail = true;
+            break;
+        case OPT_FLAKY_REPORT:
+            flaky_report = true;
+            break;
+        case OPT_SEED:
+            property_seed = strtoull(optarg, NULL, 0);
+            property_seed_set = true;
+            break;
+        case 'j':
+            test_jobs = atol(optarg);
+            break;
+        case '?':
+            printf("unknown option '%c'.\n", optopt);
+        }
+    }
+    // Benchmarks running side by side disturb each other; unless asked for,
+    // run them one at a time.
+    if(test_jobs <= 0 && test_bench) test_jobs = 1;
+    if(test_jobs <= 0) test_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if(test_jobs <= 0) test_jobs = 1;
+    // Running until failing stops at the first failure, and goes on for as
+    // long as it takes unless a number of runs is given.
+    if(until_fail && max_failures <= 0) max_failures = 1;
+    if(until_fail && !repeat_set) test_repeat = 0;
+    // A unit run over and over is run whether it changed or not.
+    bool repeating = test_repeat != 1;
+    if(repeating) test_incremental = false;
+    // Counts are only shown in the table of slowest units.
+    if(test_counters && test_slowest <= 0) test_slowest = 10;
+    if(!property_seed_set) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        property_seed = ((uint64_t)now.tv_sec << 30) ^ now.tv_nsec ^ ((uint64_t)getpid() << 44);
+    }
+
+    ihct_collect_units();
+    ihct_filters_free(&filters);
+    ihct_shard_units();
+    ihct_find_alloc_hooks();
+    ihct_find_time_hooks();
+    if(history_path && !ihct_history_load(&history, history_path)) {
+        printf("couldn't read history '%s', not using it.\n", history_path);
+    }
+    ihct_order_units();
+    if(test_list) {
+        ihct_list_units();
+        ihct_history_free(&history);
+        ihct_free_units();
+        ihct_strbuf_free(&progress);
+        ihct_strbuf_free(&summary);
+        return 0;
+    }
+    if(test_incremental) ihct_fingerprint_units();
+    unit_timeouts = malloc((unit_count ? unit_count : 1) * sizeof(*unit_timeouts));
+    for(unsigned i = 0; i < unit_count; i++) {
+        unit_timeouts[i] = test_timeout;
+        if(units[i]->timeout && !ihct_parse_duration(units[i]->timeout, &unit_timeouts[i])) {
+            printf("invalid timeout '%s' of unit '%s', using the default.\n",
+                   units[i]->timeout, units[i]->name);
+        }
+    }
+    // Allocate records, for every unit of the largest round.
+    unsigned copies = repeating ? ihct_round_copies(test_repeat) : 1;
+    records = calloc(unit_count ? unit_count * copies : 1, sizeof(ihct_record *));
+    unit_stats = calloc(unit_count ? unit_count : 1, sizeof(ihct_unit_stats));
+    unit_status = calloc(unit_count ? unit_count : 1, sizeof(unsigned));
+    unit_ran = calloc(unit_count ? unit_count : 1, sizeof(bool));
+    // Width of the name column of the benchmark report.
+    int name_width = 9;
+    for(unsigned i = 0; i < unit_count; i++) {
+        int len = strlen(units[i]->name);
+        if(len > name_width) name_width = len;
+    }
+
+    if(history_report) {
+        ihct_print_history_report(name_width);
+        ihct_history_free(&history);
+        free(unit_fingerprints);
+        free(unit_cached);
+        free(unit_timeouts);
+        unit_fingerprints = NULL;
+        unit_cached = NULL;
+        free(unit_ran);
+        free(unit_status);
+        free(unit_stats);
+        free(records);
+        ihct_free_units();
+        ihct_strbuf_free(&progress);
+        ihct_strbuf_free(&summary);
+        return 0;
+    }
+    if(reporter && report_path) {
+        report_out = fopen(report_path, "w");
+        if(!report_out) {
+            printf("couldn't write report '%s'.\n", report_path);
+            exit(EXIT_FAILURE);
+        }
+        // Written out whenever the progress line is.
+        setvbuf(report_out, NULL, _IOFBF, 1 << 16);
+    } else if(reporter) {
+        report_out = stdout;
+        text_output = false;
+    }
+
+    ihct_strbuf bench_report, bench_saved, concurrent_report;
+    ihct_strbuf_init(&bench_report);
+    ihct_strbuf_init(&bench_saved);
+    ihct_strbuf_init(&concurrent_report);
+
+    if(bench_compare_path && !ihct_baseline_load(&baseline, bench_compare_path)) {
+        printf("couldn't read baseline '%s', not comparing.\n", bench_compare_path);
+    }
+    // No reason to start more workers than there are units.
+    if((unsigned long)test_jobs > unit_count * copies) {
+        test_jobs = unit_count ? unit_count * copies : 1;
+    }
+
+    ihct_collect_suites();
+    ihct_batch_units();
+    if(repeating) unit_flaky = calloc(unit_count ? unit_count : 1, sizeof(*unit_flaky));
+    // Whether the summary already notes a unit failing (1) or leaking (2).
+    unsigned char *unit_noted = calloc(unit_count ? unit_count : 1, 1);
+    if(!unit_noted || (repeating && !unit_flaky)) {
+        printf("Couldn't allocate memory for unit results.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The zygote has to be forked while this is the only thread.
+    if(test_isolate) ihct_start_zygote();
+
+    // Fatal signals are caught process-wide, and jump back into whichever
+    // thread raised them.
+    ihct_setup_recover_action();
+
+    // start clock
+    struct timespec tbegin, tend;
+    clock_gettime(CLOCK_MONOTONIC, &tbegin);
+
+    pthread_condattr_t monotonic_attr;
+    pthread_condattr_init(&monotonic_attr);
+    pthread_condattr_setclock(&monotonic_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&result_ready, &monotonic_attr);
+    pthread_cond_init(&watchdog_wake, &monotonic_attr);
+    pthread_condattr_destroy(&monotonic_attr);
+
+    suite_deadline = tbegin;
+    timespec_add_ms(&suite_deadline, suite_timeout);
+    suite_deadline_reached = false;
+    scheduling_stopped = false;
+    published_failures = 0;
+
+    // Units are reported in the order they are collected. How many there will
+    // be isn't known beforehand when running until something fails.
+    if(reporter) reporter->begin(report_out, repeating ? 0 : unit_count);
+
+    // Run the units in rounds, each running the unit list a number of times
+    // over. Only a single round is run unless repeating.
+    progress_flushed = tbegin;
+    unsigned collected = 0;
+    unsigned long rounds_left = test_repeat;
+    for(;;) {
+        copies = repeating ? ihct_round_copies(rounds_left) : 1;
+        slot_count = unit_count * copies;
+        ihct_count_suite_units(copies);
+
+        // Start all workers, and the watchdog keeping an eye on them.
+        next_unit = 0;
+        scheduled_count = slot_count;
+        watchdog_stop = false;
+        workers = calloc(test_jobs, sizeof(ihct_worker));
+        if(!workers) {
+            printf("Couldn't allocate memory for workers.\n");
+            exit(EXIT_FAILURE);
+        }
+        for(long w = 0; w < test_jobs; w++) {
+            pthread_mutex_init(&workers[w].lock, NULL);
+            workers[w].child_fd = -1;
+            ihct_start_thread(&workers[w].tid, routine_worker, &workers[w]);
+        }
+        ihct_start_thread(&watchdog_tid, routine_watchdog, NULL);
+
+        // Collect every result in order, as they get done. The progress line is
+        // written out in batches, at most every IHCT_PROGRESS_INTERVAL.
+        for(unsigned s = 0; s < slot_count; s++) {
+            unsigned i = s % unit_count;
+            const ihct_unit *unit = units[i];
+
+            pthread_mutex_lock(&result_lock);
+            // Units past those scheduled before stopping never get a record.
+            while(!records[s] && !(scheduling_stopped && s >= scheduled_count)) {
+                if(progress.len == 0) {
+                    pthread_cond_wait(&result_ready, &result_lock);
+                    continue;
+                }
+                struct timespec flush_at = progress_flushed;
+                flush_at.tv_nsec += IHCT_PROGRESS_INTERVAL;
+                flush_at.tv_sec += flush_at.tv_nsec / 1000000000;
+                flush_at.tv_nsec %= 1000000000;
+                if(pthread_cond_timedwait(&result_ready, &result_lock, &flush_at) == ETIMEDOUT) {
+                    ihct_flush_progress();
+                }
+            }
+            ihct_record *record = records[s];
+            records[s] = NULL;
+            pthread_mutex_unlock(&result_lock);
+            ihct_unit_done(i);
+            // Runs of a unit repeated after stopping were never going to be.
+            if(!record && repeating) continue;
+            unsigned index = collected++;
+            // A benchmark slower than its baseline is reported as regressed.
+            if(record && record->bench) ihct_compare_to_baseline(record, unit);
+            ihct_report_unit_done(index, i, record);
+            if(!record || record->skipped) {
+                skipped_count++;
+                free(record);
+                continue;
+            }
+            if(record->cached) {
+                cached_count++;
+                if(index % 80 == 0 && index != 0) ihct_strbuf_append(&progress, "\n");
+                ihct_strbuf_append(&progress, IHCT_BG_BLUE IHCT_BOLD "-" IHCT_RESET);
+                free(record);
+                continue;
+            }
+
+            // ensure 80 width
+            if(index % 80 == 0 && index != 0) ihct_strbuf_append(&progress, "\n");
+
+            // A benchmark run over and over is reported for its first run.
+            ihct_bench_stats *bench = record->bench;
+            if(bench && !unit_ran[i]) {
+                ihct_add_bench_to_report(&bench_report, bench, unit, name_width);
+                ihct_baseline_append(&bench_saved, unit->name, bench->samples, bench->sample_count);
+            }
+            if(record->concurrent && !unit_ran[i]) {
+                ihct_add_concurrent_to_report(&concurrent_report, record->concurrent, unit,
+                                              name_width);
+            }
+
+            unit_stats[i] = record->stats;
+            unit_status[i] = record->result.status;
+            unit_ran[i] = true;
+            if(repeating) ihct_flaky_add(&unit_flaky[i], &record->result, record->stats.wall);
+            ihct_print_result(&record->result);
+            if(ihct_progress_due()) ihct_flush_progress();
+
+            // The summary notes how a unit first failed, and first leaked.
+            if(record->result.status) {
+                failed_count++;
+                if(!(unit_noted[i] & 1)) ihct_add_error_to_summary(record, unit);
+                unit_noted[i] |= 1;
+            }
+            if(record->stats.allocs.leaked) {
+                leaked_count++;
+                if(!(unit_noted[i] & 2)) ihct_add_leak_to_summary(&record->stats.allocs, unit);
+                unit_noted[i] |= 2;
+            }
+
+            ihct_record_clear(record);
+            free(record);
+        }
+
+        // Every unit is done; no worker can time out anymore.
+        pthread_mutex_lock(&watchdog_lock);
+        watchdog_stop = true;
+        pthread_cond_signal(&watchdog_wake);
+        pthread_mutex_unlock(&watchdog_lock);
+        pthread_join(watchdog_tid, NULL);
+
+        for(long w = 0; w < test_jobs; w++) {
+            pthread_join(workers[w].tid, NULL);
+            // Hanging up makes the child exit.
+            if(workers[w].child_fd >= 0) close(workers[w].child_fd);
+            pthread_mutex_destroy(&workers[w].lock);
+        }
+        free(workers);
+
+        if(!repeating || scheduling_stopped || !unit_count) break;
+        if(rounds_left && (rounds_left -= copies) == 0) break;
+    }
+    if(test_isolate) ihct_stop_zygote();
+    ihct_teardown_fixtures(true, 0);
+    free(unit_batches);
+    free(unit_suites);
+    free(suite_remaining);
+    free(unit_noted);
+    free(records);
+    pthread_cond_destroy(&result_ready);
+    pthread_cond_destroy(&watchdog_wake);
+
+    clock_gettime(CLOCK_MONOTONIC, &tend);
+    double elapsed = (tend.tv_sec - tbegin.tv_sec);
+    elapsed += (tend.tv_nsec - tbegin.tv_nsec) / 1000000000.0;
+
+    ihct_flush_progress();
+
+    // print all messages, along with the totals, in a single write.
+    if(summary.len > 4) {
+        ihct_strbuf_append(&progress, "\n\n");
+        ihct_strbuf_appendn(&progress, summary.data, summary.len);
+        ihct_strbuf_append(&progress, "\n");
+    } else {
+        ihct_strbuf_append(&progress, "\n\n\n");
+    }
+    ihct_strbuf_free(&summary);
+
+    if(bench_report.len) {
+        ihct_strbuf_appendf(&progress, IHCT_BOLD "%-*s %12s %12s %10s %12s %12s%s" IHCT_RESET "\n",
+            name_width, "benchmark", "ns/op", "min", "mad", "iterations", "throughput",
+            baseline.count ? "     change" : "");
+        ihct_strbuf_appendn(&progress, bench_report.data, bench_report.len);
+        ihct_strbuf_append(&progress, "\n");
+    }
+    ihct_strbuf_free(&bench_report);
+    ihct_baseline_free(&baseline);
+
+    if(concurrent_report.len) {
+        ihct_strbuf_appendf(&progress, IHCT_BOLD "%-*s %8s %12s %11s %11s %11s %11s"
+            IHCT_RESET "\n", name_width, "concurrent", "threads", "iterations", "ops/s",
+            "min/thread", "median", "max");
+        ihct_strbuf_appendn(&progress, concurrent_report.data, concurrent_report.len);
+        ihct_strbuf_append(&progress, "\n");
+    }
+    ihct_strbuf_free(&concurrent_report);
+
+    if(bench_save_path) {
+        FILE *f = fopen(bench_save_path, "w");
+        if(f) {
+            ihct_strbuf_flush(&bench_saved, f);
+            fclose(f);
+        } else {
+            ihct_strbuf_appendf(&progress, "couldn't write baseline '%s'.\n", bench_save_path);
+        }
+    }
+    ihct_strbuf_free(&bench_saved);
+
+    if(test_slowest > 0) ihct_add_slowest_to_report(name_width);
+    if(timings_save_path) ihct_save_timings();
+    if(repeating) {
+        ihct_add_flaky_to_report(name_width);
+        for(unsigned i = 0; i < unit_count; i++) ihct_flaky_free(&unit_flaky[i]);
+        free(unit_flaky);
+        unit_flaky = NULL;
+    }
+    if(history_path) ihct_save_history();
+    if(test_incremental) ihct_save_cache();
+    free(unit_fingerprints);
+    free(unit_cached);
+    free(unit_timeouts);
+    unit_fingerprints = NULL;
+    unit_cached = NULL;
+    ihct_history_free(&history);
+    free(unit_ran);
+    free(unit_status);
+    free(unit_stats);
+    ihct_free_units();
+
+    ihct_strbuf_appendf(&progress, "tests took %.2f seconds\n", elapsed);
+    unsigned run_count = collected - skipped_count - cached_count;
+    if(leaked_count) {
+        ihct_strbuf_appendf(&progress, IHCT_FG_MAGENTA "%u leaking " IHCT_RESET "of %u run\n",
+            leaked_count, run_count);
+    }
+    if(cached_count) {
+        ihct_strbuf_appendf(&progress, IHCT_FG_BLUE "%u unchanged " IHCT_RESET
+            "(passed before, not run)\n", cached_count);
+    }
+    if(skipped_count && suite_deadline_reached) {
+        ihct_strbuf_appendf(&progress, IHCT_FG_YELLOW "%u not run " IHCT_RESET
+            "(deadline of %ld ms reached)\n", skipped_count, suite_timeout);
+    } else if(skipped_count) {
+        ihct_strbuf_appendf(&progress, IHCT_FG_YELLOW "%u not run " IHCT_RESET
+            "(stopped after %u failures)\n", skipped_count, failed_count);
+    }
+    int status = 0;
+    if(failed_count) {
+        ihct_strbuf_appendf(&progress, IHCT_FG_GREEN "%u successful "
+            IHCT_RESET "and "
+            IHCT_FG_RED "%u failed "
+            IHCT_RESET "of "
+            IHCT_FG_YELLOW "%u run"
+            IHCT_RESET "\n", run_count-failed_count, failed_count, run_count);
+
+        ihct_strbuf_append(&progress, IHCT_FG_RED "FAILURE\n" IHCT_RESET);
+        status = 1;
+    } else {
+        ihct_strbuf_appendf(&progress, IHCT_FG_GREEN "%u successful "
+            IHCT_RESET "of "
+            IHCT_FG_YELLOW "%u run"
+            IHCT_RESET "\n", run_count, run_count);
+
+        ihct_strbuf_append(&progress, IHCT_FG_GREEN "SUCCESS\n" IHCT_RESET);
+    }
+    if(reporter) {
+        ihct_report_totals totals = {collected, run_count - failed_count, failed_count,
+                                     skipped_count, cached_count, elapsed, property_seed};
+        reporter->end(report_out, &totals);
+        if(report_out != stdout) fclose(report_out);
+        else fflush(stdout);
+        report_out = NULL;
+    }
+    if(text_output) ihct_strbuf_flush(&progress, stdout);
+    ihct_strbuf_free(&progress);
+    return status;
+}
+
+// Lets the program run tests on itself. This is done with the compiler flag
+// IHCT_TEST_SELF. Still requires an external main entrypoint.
+#ifdef IHCT_TEST_SELF
+#include <fcntl.h>
+
+// Create two internal test procedures, for testing the test creation.
+static void itest_true(ihct_test_result *result) {
+    IHCT_ASSERT(true);
+}
+static void itest_false(ihct_test_result *result) {
+    IHCT_ASSERT(false);
+}
+
+IHCT_TEST(self_unit_create) {
+    ihct_unit *u = ihct_init_unit("internal_true", &itest_true);
+    IHCT_ASSERT_STR(u->name, "internal_true");
+    IHCT_ASSERT(&itest_true == u->procedure);
+}
+
+IHCT_TEST(self_module_units) {
+    static const ihct_unit section[2] = {{"a", &itest_true}, {"b", &itest_false}};
+    ihct_module_units first = {.begin = section, .end = section + 2};
+    ihct_module_units second = {.begin = section, .end = section + 2};
+
+    // The same section registered twice (from two translation units) is kept once.
+    ihct_register_module_units(&first);
+    ihct_register_module_units(&second);
+    unsigned found = 0;
+    for(ihct_module_units *m = module_units; m; m = m->next) found += m->begin == section;
+    ihct_unregister_module_units(&first);
+
+    IHCT_ASSERT(found == 1);
+    for(ihct_module_units *m = module_units; m; m = m->next) IHCT_ASSERT(m != &first);
+}
+
+static void self_prop_fails_above_ten(ihct_test_result *result, ihct_gen *gen) {
+    IHCT_ASSERT(IHCT_GEN_INT(-1000, 1000) <= 10);
+}
+
+static void itest_eq_int(ihct_test_result *result) {
+    int four = 4;
+    IHCT_ASSERT_EQ_INT(2 + 2, four);
+    IHCT_ASSERT_EQ_INT(2 + 2, four + 1);
+}
+
+// A failing typed assertion notes the values of both operands.
+IHCT_TEST(self_assert_values) {
+    ihct_test_result inner = {.status = PASS};
+    itest_eq_int(&inner);
+    IHCT_ASSERT(inner.status == FAIL && inner.line == __LINE__ - 7);
+    IHCT_ASSERT_STR(inner.code, "2 + 2 == four + 1");
+    IHCT_ASSERT_STR(inner.detail, "2 + 2 = 4\nfour + 1 = 5");
+    free(inner.detail);
+}
+
+IHCT_TEST(self_dbl_ulps) {
+    IHCT_ASSERT_EQ_UINT(ihct_dbl_ulps(0.0, -0.0), 0);
+    IHCT_ASSERT_EQ_UINT(ihct_dbl_ulps(1.0, 1.0 + 2.220446049250313e-16), 1);
+    IHCT_ASSERT_EQ_UINT(ihct_dbl_ulps(-4.9406564584124654e-324, 4.9406564584124654e-324), 2);
+    IHCT_ASSERT_EQ_UINT(ihct_dbl_ulps(0.0 / 0.0, 0.0 / 0.0), ~0ULL);
+    IHCT_ASSERT_EQ_DBL(0.1 + 0.2, 0.3, 1);
+    IHCT_ASSERT_NEAR_DBL(0.1 + 0.2, 0.3, 1e-12);
+}
+
+// Every kernel finds the first difference, wherever it is and however the
+// buffers are aligned.
+IHCT_TEST(self_mismatch_kernels) {
+    unsigned char a[300], b[301];
+    for(size_t i = 0; i < sizeof(a); i++) a[i] = b[i + 1] = i * 7;
+    const ihct_mismatch_kernel *kernels;
+    size_t count = ihct_mismatch_kernels(&kernels);
+    for(size_t k = 0; k < count; k++) {
+        for(size_t n = 0; n < sizeof(a); n += 13) {
+            IHCT_ASSERT_EQ_UINT(kernels[k].proc(a, b + 1, n), n);
+            for(size_t at = 0; at < n; at += 5) {
+                b[at + 1] ^= 0x10;
+                size_t found = kernels[k].proc(a, b + 1, n);
+                b[at + 1] ^= 0x10;
+                IHCT_ASSERT_EQ_UINT(found, at);
+            }
+        }
+    }
+}
+
+static void itest_mem(ihct_test_result *result) {
+    char a[40] = "the quick brown fox jumps over the dog", b[40];
+    memcpy(b, a, sizeof(b));
+    IHCT_ASSERT_MEM(a, b, sizeof(a));
+    b[20] = 'J';
+    IHCT_ASSERT_MEM(a, b, sizeof(a));
+}
+
+static void itest_str(ihct_test_result *result) {
+    IHCT_ASSERT_STR_EQ("same", "same");
+    IHCT_ASSERT_STR_EQ("line\none", "line\nOne");
+}
+
+// Failing comparisons show the bytes, or characters, around the difference.
+IHCT_TEST(self_assert_mem) {
+    ihct_test_result inner = {.status = PASS};
+    itest_mem(&inner);
+    IHCT_ASSERT(inner.status == FAIL);
+    IHCT_ASSERT_STR_EQ(inner.detail,
+        "first difference at offset 20 (0x14) of 40 bytes\n"
+        "a 00000000  74 68 65 20 71 75 69 63 6b 20 62 72 6f 77 6e 20  |the quick brown |\n"
+        "b 00000000  74 68 65 20 71 75 69 63 6b 20 62 72 6f 77 6e 20  |the quick brown |\n"
+        "a 00000010  66 6f 78 20 6a 75 6d 70 73 20 6f 76 65 72 20 74  |fox jumps over t|\n"
+        "b 00000010  66 6f 78 20 4a 75 6d 70 73 20 6f 76 65 72 20 74  |fox Jumps over t|\n"
+        "                        ^^\n"
+        "a 00000020  68 65 20 64 6f 67 00 00                          |he dog..|\n"
+        "b 00000020  68 65 20 64 6f 67 00 00                          |he dog..|");
+    free(inner.detail);
+
+    inner = (ihct_test_result){.status = PASS};
+    itest_str(&inner);
+    IHCT_ASSERT(inner.status == FAIL);
+    IHCT_ASSERT_STR_EQ(inner.detail,
+        "first difference at index 5\n"
+        "s1: \"line\\none\"\n"
+        "s2: \"line\\nOne\"\n"
+        "           ^");
+    free(inner.detail);
+}
+
+// Runs of a unit failing alike are counted together, and durations are binned
+// closely enough for the quantiles to be near exact.
+IHCT_TEST(self_flaky_runs) {
+    ihct_flaky f = {0};
+    ihct_test_result pass = {PASS, NULL, NULL, 0, NULL};
+    ihct_test_result fail = {FAIL, "x", "a.c", 3, NULL};
+    for(int k = 1; k <= 100; k++) ihct_flaky_add(&f, &pass, k * 1e-3);
+    IHCT_ASSERT(!ihct_flaky_is_flaky(&f));
+    ihct_flaky_add(&f, &fail, 1e-3);
+    ihct_flaky_add(&f, &fail, 1e-3);
+    IHCT_ASSERT(ihct_flaky_is_flaky(&f));
+    IHCT_ASSERT_EQ_UINT(f.location_count, 1);
+    IHCT_ASSERT_EQ_UINT(f.locations[0].count, 2);
+    IHCT_ASSERT_NEAR_DBL(ihct_flaky_quantile(&f, 0.5), 0.05, 0.05 * 0.2);
+    IHCT_ASSERT_NEAR_DBL(ihct_flaky_quantile(&f, 1), 0.1, 1e-12);
+    ihct_flaky_free(&f);
+}
+
+static unsigned long self_concurrent_ops;
+static void self_concurrent_body(ihct_test_result *result, unsigned thread, uint64_t seed,
+                                 size_t iterations) {
+    for(size_t i = 0; i < iterations; i++) {
+        __atomic_add_fetch(&self_concurrent_ops, 1, __ATOMIC_RELAXED);
+    }
+    IHCT_ASSERT(thread != 2);
+}
+
+// Every thread runs the body; the one failing is named in the result.
+IHCT_TEST(self_concurrent_threads) {
+    static const ihct_unit unit = {"concurrent", .kind = IHCT_UNIT_CONCURRENT,
+        .concurrent = &self_concurrent_body, .threads = 4, .iterations = 1000};
+    ihct_test_result inner;
+    ihct_concurrent_stats stats;
+    ihct_concurrent_run(&unit, &inner, 1, 2, &stats, &ihct_concurrent_guard, NULL);
+
+    IHCT_ASSERT_EQ_UINT(__atomic_load_n(&self_concurrent_ops, __ATOMIC_RELAXED), 4000);
+    IHCT_ASSERT_EQ_UINT(stats.threads, 4);
+    bool rated = stats.rates[0] > 0 && stats.rates[3] > 0;
+    free(stats.rates);
+    IHCT_ASSERT(rated);
+    IHCT_ASSERT(inner.status == FAIL);
+    bool named = strstr(inner.detail, "thread 2 of 4 failed first") != NULL;
+    free(inner.detail);
+    IHCT_ASSERT(named);
+}
+
+static bool self_fixture_entered;
+static void *self_fixture_hangs(void) {
+    __atomic_store_n(&self_fixture_entered, true, __ATOMIC_RELEASE);
+    for(;;) pause();
+    return NULL;
+}
+static ihct_fixture self_fixture_stuck = {"stuck", IHCT_SCOPE_RUN, &self_fixture_hangs, NULL};
+
+// Requires the stuck fixture, as a unit would; canceled right away, as one
+// timed out by the watchdog is.
+static void *self_fixture_require(void *arg) {
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    void *data;
+    ihct_test_result *result = arg;
+    *result = (ihct_test_result){.status = PASS};
+    ihct_require_impl(&self_fixture_stuck, &data, result, __FILE__, __LINE__);
+    return NULL;
+}
+
+// A shared fixture whose setup is timed out fails the units requiring it,
+// both those waiting on it and those coming after, instead of hanging them.
+IHCT_TEST(self_fixture_setup_timeout) {
+    ihct_test_result first, waiting, after = {.status = PASS};
+    pthread_t setting_up, waiter;
+    pthread_create(&setting_up, NULL, &self_fixture_require, &first);
+    while(!__atomic_load_n(&self_fixture_entered, __ATOMIC_ACQUIRE)) usleep(1000);
+    pthread_create(&waiter, NULL, &self_fixture_require, &waiting);
+    usleep(10000);
+    pthread_cancel(setting_up);
+    pthread_join(setting_up, NULL);
+    pthread_join(waiter, NULL);
+    IHCT_ASSERT(waiting.status == FAIL);
+
+    void *data;
+    IHCT_NASSERT(ihct_require_impl(&self_fixture_stuck, &data, &after, __FILE__, __LINE__));
+    IHCT_ASSERT(after.status == FAIL);
+}
+
+// Hang only when run by self_isolate_timeout.
+static const int self_isolated_rows[32];
+IHCT_TEST_P(self_isolated_hangs, int, self_isolated_rows) {
+    if(getenv("IHCT_SELF_HANG")) for(;;) pause();
+}
+
+// Units timing out in child processes are all reported as such, even those
+// timing out while their child is still being spawned. Run by a fresh run of
+// this program, in a process group of its own for a stray kill not to reach
+// this run.
+IHCT_TEST(self_isolate_timeout) {
+    char path[] = "/tmp/ihct_isolateXXXXXX";
+    int fd = mkstemp(path);
+    IHCT_ASSERT(fd >= 0);
+    char output[64];
+    snprintf(output, sizeof(output), "--output=%s", path);
+    char *argv[] = {"ihct", "--isolate", "-j32", "-t1ms", "-f", "self_isolated_hangs*",
+                    "--reporter=jsonl", output, NULL};
+    char *envp[] = {"IHCT_SELF_HANG=1", NULL};
+
+    pid_t pid = fork();
+    if(pid == 0) {
+        setpgid(0, 0);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        execve("/proc/self/exe", argv, envp);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+
+    FILE *f = fdopen(fd, "r");
+    char line[512];
+    unsigned timeouts = 0;
+    while(fgets(line, sizeof(line), f)) timeouts += strstr(line, "\"status\":\"timeout\"") != NULL;
+    fclose(f);
+    unlink(path);
+    IHCT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 1);
+    IHCT_ASSERT_EQ_UINT(timeouts, 32);
+}
+
+// Every row is run as a unit of its own, given its own row and index.
+static const unsigned self_squares[] = {0, 1, 4, 9, 16};
+IHCT_TEST_P(self_param_rows, unsigned, self_squares) {
+    IHCT_ASSERT(*row == index * index);
+}
+
+// Integers are drawn closest to 0 first, so the smallest failing one is found.
+IHCT_TEST(self_property_shrinks) {
+    ihct_test_result inner;
+    ihct_property_run(&self_prop_fails_above_ten, &inner, 1, 1, 0, 100, NULL);
+    IHCT_ASSERT(inner.status == FAIL);
+    IHCT_ASSERT(inner.detail && !strncmp(inner.detail, "input: 11\n", 10));
+    free(inner.detail);
+}
+
+IHCT_TEST(self_vector_create) {
+    ihct_vector *v = ihct_vector_init();
+
+    IHCT_ASSERT(v != NULL);
+    IHCT_ASSERT(v->data == NULL);
+    IHCT_ASSERT(v->size == 0);
+
+    ihct_vector_free(v);
+}
+
+IHCT_TEST(self_vector_all) {
+    ihct_vector *v = ihct_vector_init();
+
+    for(int i = 0; i < 1000; ++i) {
+        int *t = malloc(sizeof(int));
+        *t = i * 2;
+        ihct_vector_add(v, t);
+    }
+
+    for(int i = 0; i < 1000; ++i) {
+        int *t = ihct_vector_get(v, i);
+        IHCT_ASSERT(i * 2 == *t);
+        free(t);
+    }
+
+    ihct_vector_free(v);
+}
+
+IHCT_TEST(self_strbuf_appendf) {
+    ihct_strbuf b;
+    ihct_strbuf_init(&b);
+
+    // Grows past the initial capacity, both by small and large appends.
+    for(int i = 0; i < 1000; ++i) ihct_strbuf_appendf(&b, "%d,", i % 10);
+    IHCT_ASSERT(b.len == 2000);
+    IHCT_ASSERT(b.data[b.len] == '\0');
+    IHCT_ASSERT(b.data[1998] == '9');
+
+    ihct_strbuf_appendf(&b, "%2000s", "x");
+    IHCT_ASSERT(b.len == 4000);
+    IHCT_ASSERT(b.data[3999] == 'x');
+
+    ihct_strbuf_free(&b);
+}
+
+IHCT_TEST(self_stats_median_mad) {
+    double v[] = {5, 1, 4, 2, 3, 100};
+    ihct_stats_sort(v, 6);
+    IHCT_ASSERT(v[0] == 1 && v[5] == 100);
+
+    double m = ihct_stats_median(v, 6);
+    IHCT_ASSERT(m == 3.5);
+    // Deviations are 2.5 1.5 0.5 0.5 1.5 96.5, a single outlier doesn't matter.
+    IHCT_ASSERT(ihct_stats_mad(v, 6, m) == 1.5);
+    IHCT_ASSERT(ihct_stats_median(v, 5) == 3);
+}
+
+IHCT_TEST(self_stats_mann_whitney) {
+    double a[10], b[10];
+    for(int i = 0; i < 10; ++i) {
+        a[i] = i;
+        b[i] = i + 100;
+    }
+    // Identical samples can't be told apart, disjoint ones certainly can.
+    IHCT_ASSERT(ihct_stats_mann_whitney(a, 10, a, 10) > 0.9);
+    IHCT_ASSERT(ihct_stats_mann_whitney(a, 10, b, 10) < 0.001);
+    IHCT_ASSERT(ihct_stats_mann_whitney(b, 10, a, 10) < 0.001);
+}
+
+IHCT_TEST(self_parse_duration) {
+    long ms = -1;
+    IHCT_ASSERT(ihct_parse_duration("50ms", &ms) && ms == 50);
+    IHCT_ASSERT(ihct_parse_duration("2", &ms) && ms == 2000);
+    IHCT_ASSERT(ihct_parse_duration("1.5s", &ms) && ms == 1500);
+    IHCT_ASSERT(ihct_parse_duration("1m", &ms) && ms == 60000);
+    IHCT_ASSERT(ihct_parse_duration("0.1ms", &ms) && ms == 1);
+    IHCT_NASSERT(ihct_parse_duration("2x", &ms));
+    IHCT_NASSERT(ihct_parse_duration("ms", &ms));
+}
+
+IHCT_TEST(self_filters) {
+    static const char *const slow[] = {"slow", NULL};
+    static const ihct_unit list[] = {{.name = "print_int"}, {.name = "parse_int"},
+        {.name = "parse_float", .tags = slow}, {.name = "table", .kind = IHCT_UNIT_PARAM}};
+    const ihct_unit *by_name[4];
+    bool selected[4];
+    ihct_filters_index(list, 4, by_name);
+    IHCT_ASSERT(by_name[0] == &list[2] && by_name[3] == &list[3]);
+
+    // Prefixed globs go through the name index. A parameterized test is selected
+    // by a glob naming one of its rows, which is then matched on its own.
+    ihct_filters f = {0};
+    ihct_filters_add(&f, "print_*", false);
+    ihct_filters_add(&f, "parse_i*", false);
+    ihct_filters_add(&f, "table/1", false);
+    ihct_filters_select(&f, list, by_name, 4, selected);
+    IHCT_ASSERT(selected[0] && selected[1] && !selected[2] && selected[3]);
+    ihct_unit row = list[3];
+    row.name = "table/1";
+    IHCT_ASSERT(ihct_filters_match(&f, &row));
+    row.name = "table/0";
+    IHCT_NASSERT(ihct_filters_match(&f, &row));
+    ihct_filters_free(&f);
+
+    ihct_filters_add(&f, "re:^p.*_", false);
+    ihct_filters_add(&f, "@slow", true);
+    ihct_filters_select(&f, list, by_name, 4, selected);
+    ihct_filters_free(&f);
+    IHCT_ASSERT(selected[0] && selected[1] && !selected[2]);
+}
+
+// Reports a single unit with the named reporter, and returns what it wrote.
+static char *self_report(const char *name, unsigned count, const ihct_report_unit *u) {
+    char *text;
+    size_t len;
+    FILE *out = open_memstream(&text, &len);
+    const ihct_reporter *r = ihct_reporter_find(name);
+    ihct_report_totals totals = {.units = 1};
+    r->begin(out, count);
+    r->unit(out, u);
+    r->end(out, &totals);
+    fclose(out);
+    return text;
+}
+
+IHCT_TEST(self_reporters) {
+    static const ihct_unit unit = {.name = "a<b>", .file = "x&y.c", .line = 3};
+    ihct_test_result failed = {FAIL, "s == \"&\"", "x&y.c", 4, "got \x1b[1m\"\x01\"\tend"};
+    ihct_report_unit u = {.unit = &unit, .result = &failed};
+
+    char *junit = self_report("junit", 1, &u);
+    bool escaped = strstr(junit, "<testcase name=\"a&lt;b&gt;\" classname=\"x&amp;y.c\"") &&
+                   strstr(junit, "message=\"s == &quot;&amp;&quot;\">x&amp;y.c:4\n"
+                          "got &#xfffd;[1m&quot;&#xfffd;&quot;\tend</failure>");
+    free(junit);
+    IHCT_ASSERT(escaped);
+
+    char *jsonl = self_report("jsonl", 1, &u);
+    escaped = strstr(jsonl, "\"detail\":\"got \\u001b[1m\\\"\\u0001\\\"\\tend\"}}\n") != NULL;
+    free(jsonl);
+    IHCT_ASSERT(escaped);
+
+    // A benchmark slower than its baseline fails, however it ran.
+    ihct_test_result regressed = {.status = REGRESSION};
+    u = (ihct_report_unit){.unit = &unit, .result = &regressed, .ns_per_op = 12.5};
+    jsonl = self_report("jsonl", 1, &u);
+    bool regression = strstr(jsonl, "\"status\":\"regression\",\"duration\":0.000000,"
+                         "\"ns_per_op\":12.500,\"failure\":{\"message\":"
+                         "\"regressed against baseline\"}") != NULL;
+    free(jsonl);
+    junit = self_report("junit", 1, &u);
+    regression = regression && strstr(junit, "<failure type=\"regression\"") != NULL;
+    free(junit);
+    char *tap = self_report("tap", 1, &u);
+    regression = regression && strstr(tap, "\nnot ok 1 - a<b>\n") != NULL;
+    free(tap);
+    IHCT_ASSERT(regression);
+
+    // A unit skipped as unchanged, with the plan last as the count isn't known.
+    u = (ihct_report_unit){.unit = &unit, .cached = true};
+    tap = self_report("tap", 0, &u);
+    bool skipped = !strcmp(tap, "TAP version 13\nok 1 - a<b> # SKIP unchanged\n1..1\n");
+    free(tap);
+    IHCT_ASSERT(skipped);
+}
 
-    ihct_free_vector(v);
+IHCT_TEST(self_history_append_load) {
+    char path[] = "/tmp/ihct_historyXXXXXX";
+    int fd = mkstemp(path);
+    IHCT_ASSERT(fd >= 0);
+    close(fd);
+
+    uint64_t a = ihct_history_hash("a"), b = ihct_history_hash("b");
+    ihct_history_record first[] = {{1, a, 1.0, PASS, 0}, {1, b, 2.0, FAIL, 0}};
+    ihct_history_record second[] = {{2, a, 3.0, TIMEOUT, 0}};
+    bool written = ihct_history_append(path, first, 2) && ihct_history_append(path, second, 1);
+
+    ihct_history h;
+    bool loaded = ihct_history_load(&h, path);
+    unlink(path);
+    IHCT_ASSERT(written && loaded);
+    IHCT_ASSERT(h.run_count == 2 && h.count == 2);
+
+    const ihct_history_unit *u = ihct_history_find(&h, a);
+    bool a_ok = u && u->runs == 2 && u->failures == 1 && u->failed == 2 &&
+                u->last_status == TIMEOUT && ihct_history_mean_wall(u) == 2.0;
+    u = ihct_history_find(&h, b);
+    bool b_ok = u && u->runs == 1 && u->failed == 1 && u->walls[0] == 2.0;
+    ihct_history_free(&h);
+    IHCT_ASSERT(a_ok && b_ok);
 }
 #endif
\ No newline at end of file
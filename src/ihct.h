@@ -2,37 +2,252 @@
 #define IHCT_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 // Structure for a testunits return value. Contains state, the code (assert) which
 // failed the test, and a reference to where the code is.
 typedef struct {
-    enum {PASS, FAIL, FAIL_FORCE, ERR, TIMEOUT} status;
+    enum {PASS, FAIL, FAIL_FORCE, ERR, TIMEOUT, REGRESSION} status;
     char *code;
     char *file;
     unsigned long line;
+    // More on why the unit failed, such as the input a property failed for.
+    // Allocated, or NULL.
+    char *detail;
 } ihct_test_result;
 
 // Short for a function returning a test_result pointer, with no arguments.
 typedef void (*ihct_test_proc)(ihct_test_result *);
 
+// Procedure of a benchmark, running its measured code the given number of times.
+typedef void (*ihct_bench_proc)(ihct_test_result *, size_t iterations);
+
+// Procedure of a parameterized test, run for one row of its table.
+typedef void (*ihct_param_proc)(ihct_test_result *, const void *row, size_t index);
+
+// Source of the random input of a property.
+typedef struct ihct_gen ihct_gen;
+
+// Procedure of a property, checked for one case of random input.
+typedef void (*ihct_property_proc)(ihct_test_result *, ihct_gen *gen);
+
+// Procedure of a concurrent test, run by every one of its threads, given the
+// index and seed of the thread.
+typedef void (*ihct_concurrent_proc)(ihct_test_result *, unsigned thread, uint64_t seed,
+                                     size_t iterations);
+
+// The different kinds of units. Benchmarks are only run when asked for. A
+// parameterized test is run as one unit per row of its table, and a property
+// as one unit per slice of its cases. A concurrent test is a single unit run
+// on several threads at once.
+typedef enum {IHCT_UNIT_TEST, IHCT_UNIT_BENCH, IHCT_UNIT_PARAM, IHCT_UNIT_PROPERTY,
+              IHCT_UNIT_CONCURRENT} ihct_unit_kind;
+
+// Object representing a testing unit, containing the units name and its procedure
+// (implemented test function). Units created by IHCT_TEST are static and
+// constant, and are placed in their own section of the binary.
+typedef struct {
+    const char *name;
+    ihct_test_proc procedure;
+    // Where the unit is defined.
+    const char *file;
+    unsigned long line;
+    ihct_unit_kind kind;
+    ihct_bench_proc bench;
+    // What the unit depends on besides its own code, NULL terminated. Only used
+    // to tell whether it has changed, with --incremental.
+    const char *const *deps;
+    // Tags the unit can be selected by, NULL terminated.
+    const char *const *tags;
+    // Time the unit may take, such as "50ms", instead of the default.
+    const char *timeout;
+    // The table of a parameterized test: its rows, their size and how many
+    // there are. The units it is run as each have the index of their row.
+    ihct_param_proc param;
+    const void *params;
+    size_t param_size;
+    size_t param_count;
+    size_t param_index;
+    ihct_property_proc property;
+    // A concurrent test, the number of threads it runs on and the iterations
+    // every thread runs.
+    ihct_concurrent_proc concurrent;
+    unsigned threads;
+    size_t iterations;
+    // Whether the test runs with virtual time.
+    bool virtual_time;
+} ihct_unit;
+
+// A node in the list of modules (the executable, or a shared object) that have
+// units in their unit section. Every translation unit including this header has
+// one, registered on load.
+typedef struct ihct_module_units {
+    const ihct_unit *begin;
+    const ihct_unit *end;
+    struct ihct_module_units *next;
+    // The units sorted by name, to select them by; built on registering.
+    const ihct_unit **by_name;
+} ihct_module_units;
+
+// The scope of a fixture: how widely one instance of it is shared. A test
+// fixture is set up for every test requiring it, a suite fixture once for the
+// tests of a file, and a run fixture once for all tests.
+typedef enum {IHCT_SCOPE_TEST, IHCT_SCOPE_SUITE, IHCT_SCOPE_RUN} ihct_fixture_scope;
+
+// A fixture, defined by IHCT_FIXTURE. Its setup returns the data handed to the
+// tests requiring it; the optional teardown frees it again.
+typedef struct {
+    const char *name;
+    ihct_fixture_scope scope;
+    void *(*setup)(void);
+    void (*teardown)(void *data);
+} ihct_fixture;
+
 // Called within a test. 
 bool ihct_assert_impl(bool eval, ihct_test_result *result, char *code, char *file, 
                       unsigned long line);
 
+// Slow paths of assertions, only called once they failed. The typed ones note
+// the values of both operands in the detail of the result.
+__attribute__((cold, noinline))
+void ihct_assert_fail(ihct_test_result *result, char *code, char *file, unsigned long line);
+__attribute__((cold, noinline))
+void ihct_assert_fail_int(ihct_test_result *result, long long a, long long b, char *code,
+                          char *sa, char *sb, char *file, unsigned long line);
+__attribute__((cold, noinline))
+void ihct_assert_fail_uint(ihct_test_result *result, unsigned long long a,
+                           unsigned long long b, char *code, char *sa, char *sb, char *file,
+                           unsigned long line);
+__attribute__((cold, noinline))
+void ihct_assert_fail_ptr(ihct_test_result *result, const void *a, const void *b, char *code,
+                          char *sa, char *sb, char *file, unsigned long line);
+__attribute__((cold, noinline))
+void ihct_assert_fail_dbl(ihct_test_result *result, double a, double b, char *code,
+                          char *sa, char *sb, char *file, unsigned long line);
+__attribute__((cold, noinline))
+void ihct_assert_fail_mem(ihct_test_result *result, const void *a, const void *b, size_t n,
+                          size_t offset, char *code, char *file, unsigned long line);
+__attribute__((cold, noinline))
+void ihct_assert_fail_str(ihct_test_result *result, const char *s1, const char *s2,
+                          size_t offset, char *code, char *file, unsigned long line);
+
+// Returns the first offset where the n bytes at a and b differ, or n if they
+// don't. Compares with the widest vectors the cpu has.
+size_t ihct_mem_mismatch(const void *a, const void *b, size_t n);
+
+// Returns the first index where two strings differ, or (size_t)-1 if they are
+// equal.
+size_t ihct_str_mismatch(const char *s1, const char *s2);
+
+// Returns how many representable doubles a and b are apart, or the largest
+// distance if either is NaN. Positive and negative zero are the same.
+static inline unsigned long long ihct_dbl_ulps(double a, double b) {
+    long long ia, ib;
+    if(a != a || b != b) return ~0ULL;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    // Maps the sign-magnitude bits to a scale ordered like the doubles.
+    if(ia < 0) ia = (-0x7fffffffffffffffLL - 1) - ia;
+    if(ib < 0) ib = (-0x7fffffffffffffffLL - 1) - ib;
+    return ia > ib ? (unsigned long long)ia - (unsigned long long)ib
+                   : (unsigned long long)ib - (unsigned long long)ia;
+}
+
 void ihct_pass_impl(ihct_test_result *result, char *file, unsigned long line);
 void ihct_fail_impl(ihct_test_result *result, char *file, unsigned long line);
+bool ihct_assert_max_instructions_impl(unsigned long long max, ihct_test_result *result,
+                                       char *code, char *file, unsigned long line);
+bool ihct_assert_max_allocs_impl(unsigned long max, ihct_test_result *result, char *code,
+                                 char *file, unsigned long line);
+
+// Returns the number of heap allocations made by the running test so far, or 0
+// if allocations aren't tracked.
+unsigned long ihct_alloc_count(void);
 
-// Called on test unit construction.
+// Gets the data of a fixture, setting it up if needed. Fails the test, and
+// returns false, if the fixture couldn't be set up.
+bool ihct_require_impl(ihct_fixture *fixture, void **data, ihct_test_result *result,
+                       char *file, unsigned long line);
+
+// Generators of random input, drawn within a property. Values drawn are noted,
+// to show the input a property failed for.
+long long ihct_gen_int(ihct_gen *gen, long long lo, long long hi);
+bool ihct_gen_bool(ihct_gen *gen);
+void *ihct_gen_bytes(ihct_gen *gen, size_t max, size_t *len);
+char *ihct_gen_string(ihct_gen *gen, size_t max);
+size_t ihct_gen_array_begin(ihct_gen *gen, size_t max);
+void ihct_gen_array_end(ihct_gen *gen);
+// Allocates memory freed once the case is done.
+void *ihct_gen_alloc(ihct_gen *gen, size_t size);
+
+// Creates a new unit at runtime, and adds it to the fallback unit list.
 void ihct_construct_test_impl(char *s, ihct_test_proc proc);
 
-// Runs all tests.
+// Adds a static unit to the fallback unit list. Used where unit sections aren't
+// available.
+void ihct_register_unit(const ihct_unit *unit);
+
+// Registers and unregisters the unit section of a module.
+void ihct_register_module_units(ihct_module_units *units);
+void ihct_unregister_module_units(ihct_module_units *units);
+
+// Sets the number of bytes processed by every iteration of the running benchmark.
+void ihct_bench_set_bytes(size_t bytes);
+
+// Moves the clocks of a test with virtual time on by the given number of
+// seconds. Elsewhere, sleeps for as long.
+void ihct_time_advance(double seconds);
+
+// Runs all tests. Can be run again, such as after loading or reloading modules
+// with units; every run starts over from the default options.
 int ihct_run(int argc, char **argv);
 
-// Initializes the unitlist (Has to be done before all testing units are created).
-// Using priority to ensure that the unit list is constructed before it gets populated.
-void ihct_init(void) __attribute__((constructor(101)));
+// Restricts the following runs to the units of a module, given its handle from
+// dlopen. Can be called for several modules; NULL lifts the restriction.
+void ihct_select_module(void *handle);
+
+// Initializes the fallback unit list. Done on demand, the first time a unit is
+// added to it.
+void ihct_init(void);
+
+// Units are placed in the section 'ihct_units', which the linker encloses with
+// __start_ihct_units and __stop_ihct_units. Every module (executable or shared
+// object) gets its own section, which is registered by a constructor in each of
+// its translation units. Defining IHCT_NO_SECTIONS (or using a non-ELF target)
+// falls back to registering every unit in a constructor of its own.
+#if defined(__ELF__) && !defined(IHCT_NO_SECTIONS)
+#define IHCT_UNIT_SECTION                                                               \
+    __attribute__((used, section("ihct_units"), aligned(sizeof(void *))))
+
+extern const ihct_unit __start_ihct_units[] __attribute__((weak, visibility("hidden")));
+extern const ihct_unit __stop_ihct_units[] __attribute__((weak, visibility("hidden")));
+
+static ihct_module_units ihct_this_module_units = {
+    .begin = __start_ihct_units, .end = __stop_ihct_units};
+
+static void __attribute__((constructor(102))) ihct_this_module_register(void) {
+    ihct_register_module_units(&ihct_this_module_units);
+}
+static void __attribute__((destructor)) ihct_this_module_unregister(void) {
+    ihct_unregister_module_units(&ihct_this_module_units);
+}
+
+#define IHCT_UNIT_REGISTER(id)
+#else
+#define IHCT_UNIT_SECTION
+#define IHCT_UNIT_REGISTER(id)                                                          \
+    static void __attribute__((constructor(102))) ihct_register_##id(void) {            \
+        ihct_register_unit(&ihct_unit_##id);                                            \
+    }
+#endif
+
+// Defines the static descriptor of a unit, with the given fields set.
+#define IHCT_UNIT_DEFINE(id, ...)                                                       \
+    static const ihct_unit ihct_unit_##id IHCT_UNIT_SECTION =                           \
+        {.name = #id, .file = __FILE__, .line = __LINE__, __VA_ARGS__};                 \
+    IHCT_UNIT_REGISTER(id)
 
 // Assertions
 /// @defgroup assertions Assertions
@@ -48,7 +263,7 @@ void ihct_init(void) __attribute__((constructor(101)));
 ///
 /// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
 #define IHCT_ASSERT(expr)                                                               \
-    if(!ihct_assert_impl(expr, result, #expr, __FILE__, __LINE__)) return
+    IHCT_ASSERT_FAST_(expr, #expr)
 
 /// @brief Asserts a statement inside a test unit. If the expression is true,
 /// the unit will fail the test.
@@ -57,7 +272,7 @@ void ihct_init(void) __attribute__((constructor(101)));
 ///
 /// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
 #define IHCT_NASSERT(expr)                                                              \
-    if(!ihct_assert_impl(!expr, result, "!(" #expr ")", __FILE__, __LINE__)) return
+    IHCT_ASSERT_FAST_(!(expr), "!(" #expr ")")
 
 /// @brief Asserts two strings inside a test unit to be equal. If there is any difference
 /// in the strings, the unit will fail the test.
@@ -67,8 +282,7 @@ void ihct_init(void) __attribute__((constructor(101)));
 ///
 /// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
 #define IHCT_ASSERT_STR(s1, s2)                                                         \
-    if(!ihct_assert_impl(!strcmp(s1, s2), result, #s1 " == " #s2, __FILE__,             \
-       __LINE__)) return
+    IHCT_ASSERT_FAST_(!strcmp(s1, s2), #s1 " == " #s2)
 /// @brief Asserts two strings inside a test unit not to be equal. If there is any 
 /// difference in the strings, the unit will fail the test.
 /// @ingroup assertions
@@ -77,9 +291,171 @@ void ihct_init(void) __attribute__((constructor(101)));
 ///
 /// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
 #define IHCT_NASSERT_STR(s1, s2)                                                        \
-    if(!ihct_assert_impl(strcmp(s1, s2), result, #s1 " != " #s2, __FILE__,              \
+    IHCT_ASSERT_FAST_(strcmp(s1, s2), #s1 " != " #s2)
+
+// A passing assertion is a single branch, expected not to be taken, touching
+// neither the result nor anything else. Failing calls out to a cold slow path.
+#define IHCT_ASSERT_FAST_(cond, code)                                                   \
+    do {                                                                                \
+        if(__builtin_expect(!(cond), 0)) {                                              \
+            ihct_assert_fail(result, code, __FILE__, __LINE__);                         \
+            return;                                                                     \
+        }                                                                               \
+    } while(0)
+
+// Compares a and b, both converted to type once, and notes their values if
+// the comparison fails.
+#define IHCT_ASSERT_CMP_(type, kind, a, op, b)                                          \
+    do {                                                                                \
+        type ihct_a = (a), ihct_b = (b);                                                \
+        if(__builtin_expect(!(ihct_a op ihct_b), 0)) {                                  \
+            ihct_assert_fail_##kind(result, ihct_a, ihct_b, #a " " #op " " #b, #a, #b,  \
+                                    __FILE__, __LINE__);                                \
+            return;                                                                     \
+        }                                                                               \
+    } while(0)
+
+/// @brief Typed comparisons of two values. Each operand is evaluated once,
+/// converted to long long (INT), unsigned long long (UINT) or a pointer (PTR).
+/// A passing comparison costs a single branch; a failing one fails the unit,
+/// showing the values of both operands.
+/// @ingroup assertions
+/// @code
+/// IHCT_ASSERT_EQ_INT(parse_int("-12"), -12);
+/// IHCT_ASSERT_LT_UINT(used, capacity);
+/// IHCT_ASSERT_EQ_PTR(list_find(l, 3), NULL);
+/// @endcode
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_ASSERT_EQ_INT(a, b) IHCT_ASSERT_CMP_(long long, int, a, ==, b)
+#define IHCT_ASSERT_NE_INT(a, b) IHCT_ASSERT_CMP_(long long, int, a, !=, b)
+#define IHCT_ASSERT_LT_INT(a, b) IHCT_ASSERT_CMP_(long long, int, a, <, b)
+#define IHCT_ASSERT_LE_INT(a, b) IHCT_ASSERT_CMP_(long long, int, a, <=, b)
+#define IHCT_ASSERT_EQ_UINT(a, b) IHCT_ASSERT_CMP_(unsigned long long, uint, a, ==, b)
+#define IHCT_ASSERT_NE_UINT(a, b) IHCT_ASSERT_CMP_(unsigned long long, uint, a, !=, b)
+#define IHCT_ASSERT_LT_UINT(a, b) IHCT_ASSERT_CMP_(unsigned long long, uint, a, <, b)
+#define IHCT_ASSERT_LE_UINT(a, b) IHCT_ASSERT_CMP_(unsigned long long, uint, a, <=, b)
+#define IHCT_ASSERT_EQ_PTR(a, b) IHCT_ASSERT_CMP_(const void *, ptr, a, ==, b)
+#define IHCT_ASSERT_NE_PTR(a, b) IHCT_ASSERT_CMP_(const void *, ptr, a, !=, b)
+
+/// @brief Asserts two doubles to be at most ulps representable doubles apart;
+/// 0 asks for them to be equal. NaN is never equal to anything.
+/// @ingroup assertions
+/// @param a first double to compare
+/// @param b second double to compare
+/// @param ulps the most units in the last place they may differ by
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_ASSERT_EQ_DBL(a, b, ulps)                                                  \
+    do {                                                                                \
+        double ihct_a = (a), ihct_b = (b);                                              \
+        if(__builtin_expect(ihct_dbl_ulps(ihct_a, ihct_b) > (ulps), 0)) {               \
+            ihct_assert_fail_dbl(result, ihct_a, ihct_b,                                \
+                                 #a " == " #b " (within " #ulps " ulps)", #a, #b,       \
+                                 __FILE__, __LINE__);                                   \
+            return;                                                                     \
+        }                                                                               \
+    } while(0)
+
+/// @brief Asserts two doubles to differ by at most eps.
+/// @ingroup assertions
+/// @param a first double to compare
+/// @param b second double to compare
+/// @param eps the most they may differ by
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_ASSERT_NEAR_DBL(a, b, eps)                                                 \
+    do {                                                                                \
+        double ihct_a = (a), ihct_b = (b), ihct_eps = (eps);                            \
+        if(__builtin_expect(!(ihct_a - ihct_b <= ihct_eps && ihct_b - ihct_a <= ihct_eps),\
+                            0)) {                                                       \
+            ihct_assert_fail_dbl(result, ihct_a, ihct_b, #a " == " #b " (within " #eps ")",\
+                                 #a, #b, __FILE__, __LINE__);                           \
+            return;                                                                     \
+        }                                                                               \
+    } while(0)
+
+/// @brief Asserts the n bytes at a and b to be equal. Large buffers are compared
+/// at about the speed of memory; if they differ, the rows around the first
+/// difference are shown as a hexdump.
+/// @ingroup assertions
+/// @param a first buffer to compare
+/// @param b second buffer to compare
+/// @param n number of bytes to compare
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_ASSERT_MEM(a, b, n)                                                        \
+    do {                                                                                \
+        const void *ihct_a = (a), *ihct_b = (b);                                        \
+        size_t ihct_n = (n), ihct_offset = ihct_mem_mismatch(ihct_a, ihct_b, ihct_n);   \
+        if(__builtin_expect(ihct_offset != ihct_n, 0)) {                                \
+            ihct_assert_fail_mem(result, ihct_a, ihct_b, ihct_n, ihct_offset,           \
+                                 #a " == " #b " (" #n " bytes)", __FILE__, __LINE__);   \
+            return;                                                                     \
+        }                                                                               \
+    } while(0)
+
+/// @brief Asserts two strings to be equal, like IHCT_ASSERT_STR, but compared
+/// as IHCT_ASSERT_MEM and showing both around their first difference.
+/// @ingroup assertions
+/// @param s1 first string to compare
+/// @param s2 second string to compare
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_ASSERT_STR_EQ(s1, s2)                                                      \
+    do {                                                                                \
+        const char *ihct_s1 = (s1), *ihct_s2 = (s2);                                    \
+        size_t ihct_offset = ihct_str_mismatch(ihct_s1, ihct_s2);                       \
+        if(__builtin_expect(ihct_offset != (size_t)-1, 0)) {                            \
+            ihct_assert_fail_str(result, ihct_s1, ihct_s2, ihct_offset, #s1 " == " #s2,  \
+                                 __FILE__, __LINE__);                                   \
+            return;                                                                     \
+        }                                                                               \
+    } while(0)
+
+/// @brief Asserts that the unit has so far executed at most n instructions
+/// (in user space). Instruction counts don't vary between runs the way times
+/// do. Only checked when run with --counters on a machine with a hardware PMU;
+/// otherwise the assertion always passes.
+/// @ingroup assertions
+/// @param n the maximum number of instructions.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_ASSERT_MAX_INSTRUCTIONS(n)                                                 \
+    if(!ihct_assert_max_instructions_impl(n, result, "instructions <= " #n, __FILE__,   \
+       __LINE__)) return
+
+/// @brief Asserts that the test has so far made at most n heap allocations
+/// (malloc, calloc and realloc). Allocations are only tracked when the program
+/// is linked with ihct_alloc, or has it preloaded; otherwise the assertion
+/// always passes.
+/// @ingroup assertions
+/// @param n the maximum number of allocations.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_ASSERT_MAX_ALLOCS(n)                                                       \
+    if(!ihct_assert_max_allocs_impl(n, result, "allocations <= " #n, __FILE__,          \
        __LINE__)) return
 
+/// @brief Asserts that the following block makes no heap allocations. Tracked
+/// as with IHCT_ASSERT_MAX_ALLOCS. Leaving the block with break skips the check.
+/// @ingroup assertions
+/// @code
+/// IHCT_ASSERT_NO_ALLOC {
+///     sum = hot_path(values, n);
+/// }
+/// @endcode
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_ASSERT_NO_ALLOC                                                            \
+    for(unsigned long ihct_allocs_before = ihct_alloc_count(), ihct_allocs_done = 0; ;  \
+        ihct_allocs_done = 1)                                                           \
+        if(ihct_allocs_done) {                                                          \
+            if(!ihct_assert_impl(ihct_alloc_count() == ihct_allocs_before, result,      \
+               "no allocations in block", __FILE__, __LINE__)) return;                  \
+            break;                                                                      \
+        } else
+
 /// @brief Set the test as passed and return.
 /// @ingroup assertions
 ///
@@ -112,7 +488,7 @@ void ihct_init(void) __attribute__((constructor(101)));
 #define IHCT_RUN(argc, argv)                                                            \
     ihct_run(argc, argv)
 
-// Create a new test unit, and adds it using 'ihct_add_test'.
+// Create a new test unit, placed in the unit section of the binary.
 /// @brief Create a new test unit, which can take any number of asserts.
 /// @ingroup funcs
 /// @code
@@ -125,26 +501,374 @@ void ihct_init(void) __attribute__((constructor(101)));
 /// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
 #define IHCT_TEST(name)                                                                 \
     static void test_##name(ihct_test_result *result);                                  \
-    static void __attribute__((constructor(102))) __construct_test_##name(void) {       \
-        ihct_construct_test_impl(#name, &test_##name);                                  \
+    IHCT_UNIT_DEFINE(name, .procedure = &test_##name)                                   \
+    static void test_##name(ihct_test_result *result)
+
+/// @brief Create a new test unit, with a time limit of its own. The unit times
+/// out once it has run for longer than the given duration: a number followed by
+/// ms, s or m.
+/// @ingroup funcs
+/// @code
+/// IHCT_TEST_TIMEOUT(lookup_is_fast, 50ms) {
+///     IHCT_ASSERT(lookup("key") != NULL);
+/// }
+/// @endcode
+/// @param name the name of the test.
+/// @param duration the time limit, such as 50ms or 2s.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_TEST_TIMEOUT(name, duration)                                               \
+    static void test_##name(ihct_test_result *result);                                  \
+    IHCT_UNIT_DEFINE(name, .procedure = &test_##name, .timeout = #duration)             \
+    static void test_##name(ihct_test_result *result)
+
+/// @brief Create a new test unit with tags. Units can be selected, or excluded,
+/// by tag with a filter of '@' and the tag.
+/// @ingroup funcs
+/// @code
+/// IHCT_TEST_TAGGED(read_large_file, "slow", "io") {
+///     IHCT_ASSERT(read_file("large.bin") != NULL);
+/// }
+/// @endcode
+/// @param name the name of the test.
+/// @param ... one or more tags.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_TEST_TAGGED(name, ...)                                                     \
+    static void test_##name(ihct_test_result *result);                                  \
+    static const char *const ihct_tags_##name[] = {__VA_ARGS__, NULL};                  \
+    IHCT_UNIT_DEFINE(name, .procedure = &test_##name, .tags = ihct_tags_##name)         \
+    static void test_##name(ihct_test_result *result)
+
+/// @brief Create a new test unit running with virtual time. The clocks of the
+/// thread running the test (clock_gettime, gettimeofday and time) stand still,
+/// and only move on when it sleeps (sleep, usleep, nanosleep, clock_nanosleep),
+/// which returns at once, or by IHCT_TIME_ADVANCE. Time of other threads, and
+/// the timeout of the unit, stay real, so a backoff of minutes is tested in
+/// milliseconds. Waits with a timeout on something else (pthread_cond_timedwait,
+/// poll, select) still take real time. Needs the program linked with ihct_time,
+/// or ihct_time preloaded; otherwise the test fails, as virtual time is
+/// unavailable.
+/// @ingroup funcs
+/// @code
+/// IHCT_TEST_VIRTUAL_TIME(retry_backs_off) {
+///     time_t before = time(NULL);
+///     IHCT_ASSERT(retry(connect_to_nothing, 5) == -1);
+///     IHCT_ASSERT(time(NULL) - before == 1 + 2 + 4 + 8 + 16);
+/// }
+/// @endcode
+/// @param name the name of the test.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_TEST_VIRTUAL_TIME(name)                                                    \
+    static void test_##name(ihct_test_result *result);                                  \
+    IHCT_UNIT_DEFINE(name, .procedure = &test_##name, .virtual_time = true)             \
+    static void test_##name(ihct_test_result *result)
+
+/// @brief Moves the virtual time of the test on by the given number of
+/// seconds, as if it had slept for as long. Sleeps for real without virtual
+/// time.
+/// @ingroup funcs
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_TIME_ADVANCE(seconds) ihct_time_advance(seconds)
+
+/// @brief Create a parameterized test, run once for every row of a table. Every
+/// row is a unit of its own, named after the test and the index of the row
+/// ('name/3'), with a result of its own. Rows are run in batches, spread over
+/// the workers. Within the test, 'row' points to the row and 'index' is its
+/// index.
+/// @ingroup funcs
+/// @code
+/// static const struct { int a, b, sum; } sums[] = {{1, 2, 3}, {2, 2, 4}};
+/// IHCT_TEST_P(addition, typeof(sums[0]), sums) {
+///     IHCT_ASSERT(row->a + row->b == row->sum);
+/// }
+/// @endcode
+/// @param name the name of the test.
+/// @param type the type of a row.
+/// @param table an array of rows.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_TEST_P(name, type, table)                                                  \
+    static inline __attribute__((always_inline)) void test_##name(                      \
+        ihct_test_result *result, const type *row, size_t index);                       \
+    static void ihct_param_##name(ihct_test_result *result, const void *row,            \
+                                  size_t index) {                                       \
+        test_##name(result, (const type *)row, index);                                  \
     }                                                                                   \
+    IHCT_UNIT_DEFINE(name, .kind = IHCT_UNIT_PARAM, .param = &ihct_param_##name,        \
+                     .params = table, .param_size = sizeof(type),                       \
+                     .param_count = sizeof(table) / sizeof(type))                       \
+    static inline __attribute__((always_inline)) void test_##name(                      \
+        ihct_test_result *result, const type *row, size_t index)
+
+/// @brief Create a concurrent test, to stress code shared between threads. The
+/// body runs on 'nthreads' threads at once, pinned to a cpu each where there
+/// are enough, and released together once all of them are started. Within the
+/// test, 'thread' is the index of the thread, 'seed' a seed of its own (drawn
+/// from the seed of the run, so --seed replays it) and 'iterations' the number
+/// of operations it is to do. Assertions fail the thread they are made on; the
+/// unit fails with the thread failing first, and the operations per second of
+/// every thread are reported after the run. Allocations aren't tracked.
+/// @ingroup funcs
+/// @code
+/// IHCT_TEST_CONCURRENT(queue_push_pop, 4, 100000) {
+///     for(size_t i = 0; i < iterations; i++) {
+///         queue_push(&queue, thread);
+///         IHCT_ASSERT(queue_pop(&queue) != QUEUE_EMPTY);
+///     }
+/// }
+/// @endcode
+/// @param name the name of the test.
+/// @param nthreads the number of threads to run the body on.
+/// @param niterations the number of operations every thread does.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_TEST_CONCURRENT(name, nthreads, niterations)                               \
+    static void conc_##name(ihct_test_result *result, unsigned thread, uint64_t seed,   \
+                            size_t iterations);                                         \
+    IHCT_UNIT_DEFINE(name, .kind = IHCT_UNIT_CONCURRENT, .concurrent = &conc_##name,    \
+                     .threads = nthreads, .iterations = niterations)                    \
+    static void conc_##name(ihct_test_result *result, unsigned thread, uint64_t seed,   \
+                            size_t iterations)
+
+/// @defgroup properties Properties
+/// @brief Tests checked for many cases of random input.
+///
+/// A property draws its input from generators, and asserts what has to hold
+/// for it. It is checked for --cases cases (1000 by default), split over
+/// units of up to 1000 cases each ('name/0', 'name/1' and so on), which run in
+/// parallel. The first failing case is shrunk to a minimal one, by replaying it
+/// with smaller and fewer values drawn, and shown along with the seed of the
+/// run; --seed replays it.
+
+/// @brief Create a new property.
+/// @ingroup properties
+/// @code
+/// IHCT_PROPERTY(sort_orders) {
+///     size_t n;
+///     int *a = IHCT_GEN_ARRAY(int, 100, &n, IHCT_GEN_INT(-1000, 1000));
+///     sort(a, n);
+///     for(size_t i = 1; i < n; i++) IHCT_ASSERT(a[i - 1] <= a[i]);
+/// }
+/// @endcode
+/// @param name the name of the property.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_PROPERTY(name)                                                             \
+    static void prop_##name(ihct_test_result *result, ihct_gen *gen);                   \
+    IHCT_UNIT_DEFINE(name, .kind = IHCT_UNIT_PROPERTY, .property = &prop_##name)        \
+    static void prop_##name(ihct_test_result *result, ihct_gen *gen)
+
+/// @brief Draws an integer from lo to hi (inclusive), shrinking towards 0.
+/// @ingroup properties
+#define IHCT_GEN_INT(lo, hi) ihct_gen_int(gen, lo, hi)
+
+/// @brief Draws true or false, shrinking towards false.
+/// @ingroup properties
+#define IHCT_GEN_BOOL() ihct_gen_bool(gen)
+
+/// @brief Draws a buffer of at most max bytes, and stores its length in *len.
+/// @ingroup properties
+#define IHCT_GEN_BYTES(max, len) ihct_gen_bytes(gen, max, len)
+
+/// @brief Draws a string of at most max printable characters.
+/// @ingroup properties
+#define IHCT_GEN_STRING(max) ihct_gen_string(gen, max)
+
+/// @brief Draws an array of at most max elements of the given type, each
+/// drawn by evaluating expr, and stores its length in *len.
+/// @ingroup properties
+#define IHCT_GEN_ARRAY(type, max, len, expr)                                            \
+    ({ size_t ihct_n = ihct_gen_array_begin(gen, max);                                  \
+       type *ihct_a = ihct_gen_alloc(gen, ihct_n * sizeof(type));                       \
+       for(size_t ihct_k = 0; ihct_k < ihct_n; ihct_k++) ihct_a[ihct_k] = (expr);       \
+       ihct_gen_array_end(gen);                                                         \
+       *(len) = ihct_n;                                                                 \
+       ihct_a; })
+
+/// @brief Create a new test unit, depending on the given files and symbols. With
+/// --incremental, a unit that passed is only run again once its code, or any of
+/// its dependencies, has changed. A dependency is a file name, or "sym:" and the
+/// name of a function or variable, defined in the same binary, that the test
+/// uses.
+/// @ingroup funcs
+/// @code
+/// IHCT_TEST_DEPS(parse_config, "data/config.ini", "sym:parse_line") {
+///     IHCT_ASSERT(parse_config_file("data/config.ini") == 0);
+/// }
+/// @endcode
+/// @param name the name of the test.
+/// @param ... one or more dependencies.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_TEST_DEPS(name, ...)                                                       \
+    static void test_##name(ihct_test_result *result);                                  \
+    static const char *const ihct_deps_##name[] = {__VA_ARGS__, NULL};                  \
+    IHCT_UNIT_DEFINE(name, .procedure = &test_##name, .deps = ihct_deps_##name)         \
     static void test_##name(ihct_test_result *result)
 
-/// @brief Defines a fixture with data to be preloaded before a test.
-/// A ficture is included by a IHCT_REQUIRE inside a test.
-#define IHCT_FIXTURE(name) _Static_assert(0, "Fixtures not implemented.")
+/// @defgroup bench Benchmarks
+/// @brief Microbenchmark units.
+///
+/// Benchmarks are not run along with the tests. Run them (and only them) by
+/// passing -b (--bench) to IHCT_RUN. Their samples can be saved to a baseline
+/// file with --save-baseline=FILE. Runs given --compare-baseline=FILE fail
+/// every benchmark that is significantly (by a Mann-Whitney U test) slower
+/// than in the baseline, by more than --regression-threshold percent.
+
+/// @brief Create a new benchmark unit. The body runs the measured code
+/// 'iterations' times; the runner calibrates the count until every sample takes
+/// long enough to be measured, does warm-up runs, and then reports the median,
+/// minimum and median absolute deviation of the time per iteration over many
+/// samples. Assertions can be used as in a test.
+/// @ingroup bench
+/// @code
+/// IHCT_BENCH(copy_4k) {
+///     static char src[4096], dst[4096];
+///     IHCT_BENCH_BYTES(sizeof(src));
+///     for(size_t i = 0; i < iterations; i++) {
+///         memcpy(dst, src, sizeof(src));
+///         IHCT_DO_NOT_OPTIMIZE(dst);
+///     }
+/// }
+/// @endcode
+/// @param name the name of the benchmark.
+#define IHCT_BENCH(name)                                                                \
+    static void bench_##name(ihct_test_result *result, size_t iterations);              \
+    IHCT_UNIT_DEFINE(name, .kind = IHCT_UNIT_BENCH, .bench = &bench_##name)             \
+    static void bench_##name(ihct_test_result *result, size_t iterations)
+
+/// @brief Sets the number of bytes processed per iteration, to also report the
+/// throughput of the benchmark.
+/// @ingroup bench
+#define IHCT_BENCH_BYTES(n) ihct_bench_set_bytes(n)
+
+/// @brief Forces the compiler to compute value, and keep it, even though it is
+/// never used.
+/// @ingroup bench
+#define IHCT_DO_NOT_OPTIMIZE(value) __asm__ volatile("" : : "r,m"(value) : "memory")
+
+/// @brief Forces the compiler to assume all memory has been read and written,
+/// so stores done by the measured code can't be removed.
+/// @ingroup bench
+#define IHCT_CLOBBER() __asm__ volatile("" : : : "memory")
+
+// Fixtures
+/// @defgroup fixtures Fixtures
+/// @brief Data shared by tests, set up once and torn down when no longer needed.
+///
+/// A fixture is set up lazily, by the first test requiring it, and shared by
+/// every test of its scope, also across workers. Tests must only read it. A
+/// test fixture is torn down when the test finishes, a suite fixture when the
+/// last test of its file has finished, and a run fixture at the end of the
+/// run. With --isolate, every child process sets up fixtures of its own, and
+/// tears down suite and run fixtures when it exits.
+
+/// @brief Defines a fixture. The body sets up its data, and returns it.
+/// @ingroup fixtures
+/// @code
+/// IHCT_FIXTURE(big_index, RUN) {
+///     return index_build("data/words.txt");
+/// }
+/// @endcode
+/// @param name the name of the fixture.
+/// @param scope TEST, SUITE or RUN.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_FIXTURE(name, scope)                                                       \
+    static void *fixture_setup_##name(void);                                            \
+    ihct_fixture ihct_fixture_##name = {#name, IHCT_SCOPE_##scope,                      \
+                                        &fixture_setup_##name, NULL};                   \
+    static void *fixture_setup_##name(void)
+
+/// @brief Defines the teardown of a fixture, given its data as 'data'. Has to
+/// follow the IHCT_FIXTURE of the fixture.
+/// @ingroup fixtures
+/// @code
+/// IHCT_FIXTURE_TEARDOWN(big_index) {
+///     index_free(data);
+/// }
+/// @endcode
+/// @param name the name of the fixture.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_FIXTURE_TEARDOWN(name)                                                     \
+    static void fixture_teardown_##name(void *data);                                    \
+    static void __attribute__((constructor)) ihct_fixture_teardown_##name(void) {       \
+        ihct_fixture_##name.teardown = &fixture_teardown_##name;                        \
+    }                                                                                   \
+    static void fixture_teardown_##name(void *data)
+
+/// @brief Declares a fixture defined in another file, to require it here.
+/// @ingroup fixtures
+/// @param name the name of the fixture.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_FIXTURE_EXTERN(name) extern ihct_fixture ihct_fixture_##name
 
-/// @brief Make the test require the given fixtures.
-/// @param ... one or more fixture names.
-#define IHCT_REQUIRE(...) _Static_assert(0, "Fixture requirements not implemented.")
+/// @brief Makes the test require a fixture, and evaluates to its data. If the
+/// fixture couldn't be set up, the test fails.
+/// @ingroup fixtures
+/// @code
+/// IHCT_TEST(index_lookup) {
+///     index *idx = IHCT_REQUIRE(big_index);
+///     IHCT_ASSERT(index_find(idx, "word") != NULL);
+/// }
+/// @endcode
+/// @param name the name of the fixture.
+///
+/// Can be shortened to remove 'IHCT_' prefix by defining IHCT_SHORT.
+#define IHCT_REQUIRE(name)                                                              \
+    ({ void *ihct_data;                                                                 \
+       if(!ihct_require_impl(&ihct_fixture_##name, &ihct_data, result, __FILE__,        \
+          __LINE__)) return;                                                            \
+       ihct_data; })
 
 #ifdef IHCT_SHORT
 #define TEST(name) IHCT_TEST(name)
+#define TEST_DEPS(name, ...) IHCT_TEST_DEPS(name, __VA_ARGS__)
+#define TEST_TAGGED(name, ...) IHCT_TEST_TAGGED(name, __VA_ARGS__)
+#define TEST_TIMEOUT(name, duration) IHCT_TEST_TIMEOUT(name, duration)
+#define TEST_VIRTUAL_TIME(name) IHCT_TEST_VIRTUAL_TIME(name)
+#define TIME_ADVANCE(seconds) IHCT_TIME_ADVANCE(seconds)
+#define TEST_P(name, type, table) IHCT_TEST_P(name, type, table)
+#define TEST_CONCURRENT(name, nthreads, niterations)                                    \
+    IHCT_TEST_CONCURRENT(name, nthreads, niterations)
+#define PROPERTY(name) IHCT_PROPERTY(name)
+#define GEN_INT(lo, hi) IHCT_GEN_INT(lo, hi)
+#define GEN_BOOL() IHCT_GEN_BOOL()
+#define GEN_BYTES(max, len) IHCT_GEN_BYTES(max, len)
+#define GEN_STRING(max) IHCT_GEN_STRING(max)
+#define GEN_ARRAY(type, max, len, expr) IHCT_GEN_ARRAY(type, max, len, expr)
+#define BENCH(name) IHCT_BENCH(name)
 #define ASSERT(expr) IHCT_ASSERT(expr)
 #define NASSERT(expr) IHCT_NASSERT(expr)
 #define ASSERT_STR(s1, s2) IHCT_ASSERT_STR(s1, s2)
 #define NASSERT_STR(s1, s2) IHCT_NASSERT_STR(s1, s2)
+#define ASSERT_EQ_INT(a, b) IHCT_ASSERT_EQ_INT(a, b)
+#define ASSERT_NE_INT(a, b) IHCT_ASSERT_NE_INT(a, b)
+#define ASSERT_LT_INT(a, b) IHCT_ASSERT_LT_INT(a, b)
+#define ASSERT_LE_INT(a, b) IHCT_ASSERT_LE_INT(a, b)
+#define ASSERT_EQ_UINT(a, b) IHCT_ASSERT_EQ_UINT(a, b)
+#define ASSERT_NE_UINT(a, b) IHCT_ASSERT_NE_UINT(a, b)
+#define ASSERT_LT_UINT(a, b) IHCT_ASSERT_LT_UINT(a, b)
+#define ASSERT_LE_UINT(a, b) IHCT_ASSERT_LE_UINT(a, b)
+#define ASSERT_EQ_PTR(a, b) IHCT_ASSERT_EQ_PTR(a, b)
+#define ASSERT_NE_PTR(a, b) IHCT_ASSERT_NE_PTR(a, b)
+#define ASSERT_EQ_DBL(a, b, ulps) IHCT_ASSERT_EQ_DBL(a, b, ulps)
+#define ASSERT_NEAR_DBL(a, b, eps) IHCT_ASSERT_NEAR_DBL(a, b, eps)
+#define ASSERT_MEM(a, b, n) IHCT_ASSERT_MEM(a, b, n)
+#define ASSERT_STR_EQ(s1, s2) IHCT_ASSERT_STR_EQ(s1, s2)
+#define ASSERT_MAX_INSTRUCTIONS(n) IHCT_ASSERT_MAX_INSTRUCTIONS(n)
+#define ASSERT_MAX_ALLOCS(n) IHCT_ASSERT_MAX_ALLOCS(n)
+#define ASSERT_NO_ALLOC IHCT_ASSERT_NO_ALLOC
 #define PASS() IHCT_PASS()
+#define FIXTURE(name, scope) IHCT_FIXTURE(name, scope)
+#define FIXTURE_TEARDOWN(name) IHCT_FIXTURE_TEARDOWN(name)
+#define FIXTURE_EXTERN(name) IHCT_FIXTURE_EXTERN(name)
+#define REQUIRE(name) IHCT_REQUIRE(name)
 #define FAIL() IHCT_FAIL()
 #endif
 
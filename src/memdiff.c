@@ -0,0 +1,205 @@
+#include "memdiff.h"
+#include "ihct.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define IHCT_MEMDIFF_X86
+#include <immintrin.h>
+#endif
+
+// Compares a word at a time, and the differing word a byte at a time.
+static size_t ihct_mismatch_scalar(const unsigned char *a, const unsigned char *b, size_t n) {
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+        uint64_t x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        if(x != y) break;
+    }
+    for(; i < n; i++) {
+        if(a[i] != b[i]) return i;
+    }
+    return n;
+}
+
+#ifdef IHCT_MEMDIFF_X86
+// The vector kernels compare four vectors per iteration, combining them into a
+// single mask, and only look for the byte once a block differs. Loads are
+// unaligned; on buffers this large they are as fast as aligned ones.
+__attribute__((target("sse2")))
+static size_t ihct_mismatch_sse2(const unsigned char *a, const unsigned char *b, size_t n) {
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64) {
+        __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+                                    _mm_loadu_si128((const __m128i *)(b + i)));
+        __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 16)),
+                                    _mm_loadu_si128((const __m128i *)(b + i + 16)));
+        __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 32)),
+                                    _mm_loadu_si128((const __m128i *)(b + i + 32)));
+        __m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 48)),
+                                    _mm_loadu_si128((const __m128i *)(b + i + 48)));
+        __m128i eq = _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+        if(_mm_movemask_epi8(eq) != 0xffff) break;
+    }
+    for(; i + 16 <= n; i += 16) {
+        unsigned ne = ~_mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)(a + i)),
+            _mm_loadu_si128((const __m128i *)(b + i)))) & 0xffff;
+        if(ne) return i + __builtin_ctz(ne);
+    }
+    return i + ihct_mismatch_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t ihct_mismatch_avx2(const unsigned char *a, const unsigned char *b, size_t n) {
+    size_t i = 0;
+    for(; i + 128 <= n; i += 128) {
+        __m256i e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                       _mm256_loadu_si256((const __m256i *)(b + i)));
+        __m256i e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 32)),
+                                       _mm256_loadu_si256((const __m256i *)(b + i + 32)));
+        __m256i e2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 64)),
+                                       _mm256_loadu_si256((const __m256i *)(b + i + 64)));
+        __m256i e3 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 96)),
+                                       _mm256_loadu_si256((const __m256i *)(b + i + 96)));
+        __m256i eq = _mm256_and_si256(_mm256_and_si256(e0, e1), _mm256_and_si256(e2, e3));
+        if((unsigned)_mm256_movemask_epi8(eq) != 0xffffffffu) break;
+    }
+    for(; i + 32 <= n; i += 32) {
+        unsigned ne = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i *)(a + i)),
+            _mm256_loadu_si256((const __m256i *)(b + i))));
+        if(ne) return i + __builtin_ctz(ne);
+    }
+    return i + ihct_mismatch_sse2(a + i, b + i, n - i);
+}
+#endif
+
+static ihct_mismatch_kernel ihct_kernels[3];
+static size_t ihct_kernel_count;
+static ihct_mismatch_proc ihct_mismatch;
+
+size_t ihct_mismatch_kernels(const ihct_mismatch_kernel **kernels) {
+    // Found once; every thread finds the same ones, so racing is harmless.
+    size_t count = __atomic_load_n(&ihct_kernel_count, __ATOMIC_ACQUIRE);
+    if(!count) {
+        ihct_kernels[count++] = (ihct_mismatch_kernel){"scalar", &ihct_mismatch_scalar};
+#ifdef IHCT_MEMDIFF_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("sse2")) {
+            ihct_kernels[count++] = (ihct_mismatch_kernel){"sse2", &ihct_mismatch_sse2};
+        }
+        if(__builtin_cpu_supports("avx2")) {
+            ihct_kernels[count++] = (ihct_mismatch_kernel){"avx2", &ihct_mismatch_avx2};
+        }
+#endif
+        __atomic_store_n(&ihct_kernel_count, count, __ATOMIC_RELEASE);
+    }
+    *kernels = ihct_kernels;
+    return count;
+}
+
+size_t ihct_mem_mismatch(const void *a, const void *b, size_t n) {
+    ihct_mismatch_proc proc = __atomic_load_n(&ihct_mismatch, __ATOMIC_ACQUIRE);
+    if(!proc) {
+        const ihct_mismatch_kernel *kernels;
+        size_t count = ihct_mismatch_kernels(&kernels);
+        proc = kernels[count - 1].proc;
+        __atomic_store_n(&ihct_mismatch, proc, __ATOMIC_RELEASE);
+    }
+    if(a == b) return n;
+    return proc(a, b, n);
+}
+
+size_t ihct_str_mismatch(const char *s1, const char *s2) {
+    size_t n1 = strlen(s1), n2 = strlen(s2);
+    // The terminator of the shorter one differs from the other, if nothing before.
+    size_t n = (n1 < n2 ? n1 : n2) + 1;
+    size_t offset = ihct_mem_mismatch(s1, s2, n);
+    return offset == n ? (size_t)-1 : offset;
+}
+
+static void ihct_memdiff_row(ihct_strbuf *out, char name, const unsigned char *p, size_t n,
+                             size_t row) {
+    ihct_strbuf_appendf(out, "%c %08zx ", name, row);
+    for(size_t i = row; i < row + 16; i++) {
+        if(i < n) ihct_strbuf_appendf(out, " %02x", p[i]);
+        else ihct_strbuf_append(out, "   ");
+    }
+    ihct_strbuf_append(out, "  |");
+    for(size_t i = row; i < row + 16 && i < n; i++) {
+        char c = p[i] >= 0x20 && p[i] < 0x7f ? p[i] : '.';
+        ihct_strbuf_appendn(out, &c, 1);
+    }
+    ihct_strbuf_append(out, "|\n");
+}
+
+void ihct_memdiff_hexdump(ihct_strbuf *out, const unsigned char *a, const unsigned char *b,
+                          size_t n, size_t offset) {
+    ihct_strbuf_appendf(out, "first difference at offset %zu (%#zx) of %zu bytes\n", offset,
+                        offset, n);
+    // The row of the difference comes after at most one row before it.
+    size_t row = offset & ~(size_t)15;
+    if(row >= 16) row -= 16;
+    for(int r = 0; r < IHCT_MEMDIFF_ROWS && row < n; r++, row += 16) {
+        ihct_memdiff_row(out, 'a', a, n, row);
+        ihct_memdiff_row(out, 'b', b, n, row);
+        size_t last = row + 16 < n ? row + 16 : n;
+        while(last > row && a[last - 1] == b[last - 1]) last--;
+        if(last == row) continue;
+        ihct_strbuf_append(out, "           ");
+        for(size_t i = row; i < last; i++) ihct_strbuf_append(out, a[i] != b[i] ? " ^^" : "   ");
+        ihct_strbuf_append(out, "\n");
+    }
+    // Drop the last newline; the summary ends every line of a detail.
+    if(out->len && out->data[out->len - 1] == '\n') out->data[--out->len] = '\0';
+}
+
+// Appends a character as it would be written in a C string. Returns its width.
+static int ihct_memdiff_char(ihct_strbuf *out, unsigned char c) {
+    switch(c) {
+    case '\n': ihct_strbuf_append(out, "\\n"); return 2;
+    case '\t': ihct_strbuf_append(out, "\\t"); return 2;
+    case '\r': ihct_strbuf_append(out, "\\r"); return 2;
+    case '"': ihct_strbuf_append(out, "\\\""); return 2;
+    case '\\': ihct_strbuf_append(out, "\\\\"); return 2;
+    }
+    if(c < 0x20 || c >= 0x7f) {
+        ihct_strbuf_appendf(out, "\\x%02x", c);
+        return 4;
+    }
+    ihct_strbuf_appendn(out, (const char *)&c, 1);
+    return 1;
+}
+
+// Appends s around offset, and returns the width up to offset.
+static int ihct_memdiff_excerpt(ihct_strbuf *out, const char *name, const char *s,
+                                size_t offset) {
+    size_t len = strlen(s);
+    size_t begin = offset > IHCT_MEMDIFF_BEFORE ? offset - IHCT_MEMDIFF_BEFORE : 0;
+    size_t end = offset + IHCT_MEMDIFF_AFTER < len ? offset + IHCT_MEMDIFF_AFTER : len;
+    int width = strlen(name) + 2;
+    ihct_strbuf_appendf(out, "%s: ", name);
+    if(begin > 0) {
+        ihct_strbuf_append(out, "...");
+        width += 3;
+    }
+    ihct_strbuf_append(out, "\"");
+    width++;
+    for(size_t i = begin; i < end; i++) {
+        int w = ihct_memdiff_char(out, s[i]);
+        if(i < offset) width += w;
+    }
+    ihct_strbuf_append(out, end < len ? "\"...\n" : "\"\n");
+    return width;
+}
+
+void ihct_memdiff_strings(ihct_strbuf *out, const char *s1, const char *s2, size_t offset) {
+    ihct_strbuf_appendf(out, "first difference at index %zu\n", offset);
+    int width = ihct_memdiff_excerpt(out, "s1", s1, offset);
+    ihct_memdiff_excerpt(out, "s2", s2, offset);
+    // Both excerpts start alike, so the difference is at the same column.
+    ihct_strbuf_appendf(out, "%*s^", width, "");
+}
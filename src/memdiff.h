@@ -0,0 +1,38 @@
+#ifndef IHCT_MEMDIFF_H
+#define IHCT_MEMDIFF_H
+
+#include "strbuf.h"
+
+#include <stddef.h>
+
+// Finds the first offset where a and b differ, out of n bytes. Returns n if
+// they don't.
+typedef size_t (*ihct_mismatch_proc)(const unsigned char *a, const unsigned char *b, size_t n);
+
+// A kernel finding mismatches, for some instruction set.
+typedef struct {
+    const char *name;
+    ihct_mismatch_proc proc;
+} ihct_mismatch_kernel;
+
+// Gets the kernels the cpu supports, slowest first. The last one is the one
+// used by ihct_mem_mismatch.
+size_t ihct_mismatch_kernels(const ihct_mismatch_kernel **kernels);
+
+// Most rows of 16 bytes shown around the first difference of two buffers.
+#define IHCT_MEMDIFF_ROWS 4
+
+// Most characters of two strings shown before and after their first difference.
+#define IHCT_MEMDIFF_BEFORE 24
+#define IHCT_MEMDIFF_AFTER 40
+
+// Appends a hexdump of the rows of a and b around offset, where they first
+// differ, to out. Bytes that differ are marked below the rows of b.
+void ihct_memdiff_hexdump(ihct_strbuf *out, const unsigned char *a, const unsigned char *b,
+                          size_t n, size_t offset);
+
+// Appends both strings around offset, where they first differ, to out, with
+// the difference marked below.
+void ihct_memdiff_strings(ihct_strbuf *out, const char *s1, const char *s2, size_t offset);
+
+#endif
@@ -0,0 +1,422 @@
+#include "property.h"
+#include "strbuf.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Input is drawn as a sequence of choices, each a number below some bound,
+// which generators turn into values. Generators are written so that smaller
+// choices make simpler values, and running out of choices (when replaying)
+// draws zeros. A failing case is then shrunk by editing its choices (removing
+// some, or making them smaller) and replaying it, keeping every edit it still
+// fails with.
+struct ihct_gen {
+    // State of the xoshiro256** generator the choices are drawn from.
+    uint64_t s[4];
+    // The choices drawn so far, or to be replayed.
+    uint64_t *choices;
+    size_t count, cap;
+    bool replaying;
+    size_t pos;
+    // The values drawn, as shown for a failing case. Only noted when replaying
+    // the case found in the end; formatting every value of every case would
+    // take longer than most properties. first is set before the first value of
+    // a list.
+    bool noting;
+    ihct_strbuf input;
+    bool first;
+    // Memory allocated for the case.
+    void **blocks;
+    size_t block_count, block_cap;
+    // The case being run, to describe it if it crashes.
+    unsigned long index;
+    // Pauses and resumes allocation tracking, or NULL.
+    void (*pause)(bool);
+};
+
+// The property running on this thread, if any.
+static __thread ihct_gen *running_gen;
+
+static uint64_t ihct_splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t ihct_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t ihct_xoshiro_next(uint64_t s[4]) {
+    uint64_t result = ihct_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = ihct_rotl(s[3], 45);
+    return result;
+}
+
+uint64_t ihct_property_seed(uint64_t run_seed, const char *name) {
+    uint64_t h = 14695981039346656037ULL;
+    for(; *name && *name != '/'; name++) {
+        h ^= (unsigned char)*name;
+        h *= 1099511628211ULL;
+    }
+    return run_seed ^ h;
+}
+
+static void ihct_gen_reserve(ihct_gen *g, size_t n) {
+    if(n <= g->cap) return;
+    size_t cap = g->cap ? g->cap * 2 : 64;
+    if(cap < n) cap = n;
+    uint64_t *p = realloc(g->choices, cap * sizeof(uint64_t));
+    if(!p) {
+        printf("Couldn't allocate memory for property.\n");
+        exit(EXIT_FAILURE);
+    }
+    g->choices = p;
+    g->cap = cap;
+}
+
+// Draws a choice below bound, or any choice for a bound of 0.
+static uint64_t ihct_gen_choice(ihct_gen *g, uint64_t bound) {
+    uint64_t c;
+    if(g->replaying) {
+        c = g->pos < g->count ? g->choices[g->pos] : 0;
+        if(bound) c %= bound;
+        // Keep what was actually used, for when this replay is kept.
+        if(g->pos < g->count) g->choices[g->pos] = c;
+    } else {
+        c = ihct_xoshiro_next(g->s);
+        if(bound) c %= bound;
+        ihct_gen_reserve(g, g->count + 1);
+        g->choices[g->count++] = c;
+    }
+    g->pos++;
+    return c;
+}
+
+// Starts noting a value, separating it from the one before. Returns false if
+// values aren't noted.
+static bool ihct_gen_note_begin(ihct_gen *g) {
+    if(!g->noting) return false;
+    if(!g->first) ihct_strbuf_append(&g->input, ", ");
+    g->first = false;
+    return true;
+}
+
+void *ihct_gen_alloc(ihct_gen *g, size_t size) {
+    if(g->block_count == g->block_cap) {
+        size_t cap = g->block_cap ? g->block_cap * 2 : 16;
+        void **p = realloc(g->blocks, cap * sizeof(void *));
+        if(!p) {
+            printf("Couldn't allocate memory for property.\n");
+            exit(EXIT_FAILURE);
+        }
+        g->blocks = p;
+        g->block_cap = cap;
+    }
+    // Never NULL, even for empty arrays.
+    void *p = malloc(size ? size : 1);
+    if(!p) {
+        printf("Couldn't allocate memory for property.\n");
+        exit(EXIT_FAILURE);
+    }
+    g->blocks[g->block_count++] = p;
+    return p;
+}
+
+// Values are ordered by their distance to the value closest to 0 in range,
+// alternating above and below it.
+long long ihct_gen_int(ihct_gen *g, long long lo, long long hi) {
+    if(hi < lo) {
+        long long t = lo;
+        lo = hi;
+        hi = t;
+    }
+    long long origin = lo > 0 ? lo : hi < 0 ? hi : 0;
+    uint64_t up = (uint64_t)hi - (uint64_t)origin;
+    uint64_t down = (uint64_t)origin - (uint64_t)lo;
+    // Wraps to 0, any choice, for the full range.
+    uint64_t c = ihct_gen_choice(g, up + down + 1);
+    uint64_t m = up < down ? up : down;
+
+    uint64_t v;
+    if(c <= 2 * m) {
+        uint64_t k = (c + 1) / 2;
+        v = c & 1 ? (uint64_t)origin + k : (uint64_t)origin - k;
+    } else if(up > down) {
+        v = (uint64_t)origin + m + (c - 2 * m);
+    } else {
+        v = (uint64_t)origin - m - (c - 2 * m);
+    }
+
+    if(ihct_gen_note_begin(g)) ihct_strbuf_appendf(&g->input, "%lld", (long long)v);
+    return (long long)v;
+}
+
+bool ihct_gen_bool(ihct_gen *g) {
+    bool b = ihct_gen_choice(g, 2);
+    if(ihct_gen_note_begin(g)) ihct_strbuf_append(&g->input, b ? "true" : "false");
+    return b;
+}
+
+void *ihct_gen_bytes(ihct_gen *g, size_t max, size_t *len) {
+    size_t n = ihct_gen_choice(g, (uint64_t)max + 1);
+    unsigned char *p = ihct_gen_alloc(g, n);
+    for(size_t i = 0; i < n; i++) p[i] = ihct_gen_choice(g, 256);
+
+    if(ihct_gen_note_begin(g)) {
+        ihct_strbuf_append(&g->input, "{");
+        for(size_t i = 0; i < n; i++) ihct_strbuf_appendf(&g->input, i ? " %02x" : "%02x", p[i]);
+        ihct_strbuf_append(&g->input, "}");
+    }
+    *len = n;
+    return p;
+}
+
+// Printable characters, simplest first.
+static const char ihct_gen_chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                     "0123456789 !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+
+char *ihct_gen_string(ihct_gen *g, size_t max) {
+    size_t n = ihct_gen_choice(g, (uint64_t)max + 1);
+    char *s = ihct_gen_alloc(g, n + 1);
+    for(size_t i = 0; i < n; i++) {
+        s[i] = ihct_gen_chars[ihct_gen_choice(g, sizeof(ihct_gen_chars) - 1)];
+    }
+    s[n] = '\0';
+
+    if(ihct_gen_note_begin(g)) {
+        ihct_strbuf_append(&g->input, "\"");
+        for(size_t i = 0; i < n; i++) {
+            if(s[i] == '"' || s[i] == '\\') ihct_strbuf_append(&g->input, "\\");
+            ihct_strbuf_appendn(&g->input, &s[i], 1);
+        }
+        ihct_strbuf_append(&g->input, "\"");
+    }
+    return s;
+}
+
+size_t ihct_gen_array_begin(ihct_gen *g, size_t max) {
+    size_t n = ihct_gen_choice(g, (uint64_t)max + 1);
+    if(ihct_gen_note_begin(g)) {
+        ihct_strbuf_append(&g->input, "[");
+        g->first = true;
+    }
+    return n;
+}
+
+void ihct_gen_array_end(ihct_gen *g) {
+    if(!g->noting) return;
+    ihct_strbuf_append(&g->input, "]");
+    g->first = false;
+}
+
+// Runs a case, from the choices of the generator or new ones. Returns whether
+// it passed.
+static bool ihct_property_case(ihct_gen *g, ihct_property_proc proc, ihct_test_result *result) {
+    for(size_t i = 0; i < g->block_count; i++) free(g->blocks[i]);
+    g->block_count = 0;
+    g->input.len = 0;
+    ihct_strbuf_append(&g->input, "");
+    g->first = true;
+    g->pos = 0;
+    if(!g->replaying) g->count = 0;
+
+    *result = (ihct_test_result){.status = PASS};
+    proc(result, g);
+    // The values a typed assertion failed with are only kept, like the input,
+    // for the case found in the end.
+    if(result->detail && !g->noting) {
+        if(g->pause) g->pause(true);
+        free(result->detail);
+        result->detail = NULL;
+        if(g->pause) g->pause(false);
+    }
+    return result->status == PASS;
+}
+
+// Replays the case with the given choices instead. If it still fails, they
+// (as far as used) become the choices of the case.
+static bool ihct_property_try(ihct_gen *g, ihct_property_proc proc, ihct_test_result *result,
+                              const uint64_t *choices, size_t n) {
+    ihct_gen_reserve(g, n);
+    memmove(g->choices, choices, n * sizeof(uint64_t));
+    g->count = n;
+    g->replaying = true;
+
+    ihct_test_result r;
+    if(ihct_property_case(g, proc, &r)) return false;
+    if(g->pos < g->count) g->count = g->pos;
+    *result = r;
+    return true;
+}
+
+// Shrinks the failing case the generator has the choices of. Returns the number
+// of times it got smaller.
+static unsigned ihct_property_shrink(ihct_gen *g, ihct_property_proc proc,
+                                     ihct_test_result *result) {
+    uint64_t *best = NULL;
+    size_t n = 0;
+    unsigned shrinks = 0, tries = 0;
+
+    bool progress = true;
+    while(progress && tries < IHCT_PROPERTY_SHRINK_LIMIT) {
+        progress = false;
+        free(best);
+        n = g->count;
+        best = malloc(n * sizeof(uint64_t) + 1);
+        uint64_t *cand = malloc(n * sizeof(uint64_t) + 1);
+        if(!best || !cand) {
+            printf("Couldn't allocate memory for property.\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(best, g->choices, n * sizeof(uint64_t));
+
+        // Remove runs of choices, largest first. The length of whatever they were
+        // drawn for is drawn before them, so also try making one of the choices
+        // right before smaller.
+        for(size_t k = 8; k > 0 && tries < IHCT_PROPERTY_SHRINK_LIMIT; k /= 2) {
+            for(size_t i = n >= k ? n - k + 1 : 0; i-- > 0 && tries < IHCT_PROPERTY_SHRINK_LIMIT;) {
+                if(i + k > n) continue;
+                memcpy(cand, best, i * sizeof(uint64_t));
+                memcpy(cand + i, best + i + k, (n - i - k) * sizeof(uint64_t));
+                size_t j = i;
+                bool removed = false;
+                do {
+                    if(j < i) {
+                        if(cand[j] < k) continue;
+                        cand[j] -= k;
+                    }
+                    tries++;
+                    removed = ihct_property_try(g, proc, result, cand, n - k);
+                    if(j < i) cand[j] += k;
+                } while(!removed && j-- > 0 && i - j <= IHCT_PROPERTY_SHRINK_REACH &&
+                        tries < IHCT_PROPERTY_SHRINK_LIMIT);
+                if(removed) {
+                    n = g->count;
+                    memcpy(best, g->choices, n * sizeof(uint64_t));
+                    shrinks++;
+                    progress = true;
+                }
+            }
+        }
+
+        // Make every choice as small as it can be, by bisection. Integers
+        // alternate in sign, so bisect over choices of the same parity first.
+        for(size_t i = 0; i < n && tries < IHCT_PROPERTY_SHRINK_LIMIT; i++) {
+            for(uint64_t step = 2; step > 0 && i < n; step--) {
+                uint64_t lo = 0, hi = best[i];
+                if(step == 2) lo = hi & 1;
+                while(lo < hi && i < n && tries < IHCT_PROPERTY_SHRINK_LIMIT) {
+                    uint64_t mid = lo + (hi - lo) / 2;
+                    if(step == 2 && (mid & 1) != (hi & 1)) mid++;
+                    if(mid >= hi) break;
+                    memcpy(cand, best, n * sizeof(uint64_t));
+                    cand[i] = mid;
+                    tries++;
+                    if(ihct_property_try(g, proc, result, cand, n)) {
+                        n = g->count;
+                        memcpy(best, g->choices, n * sizeof(uint64_t));
+                        hi = i < n ? best[i] : 0;
+                        shrinks++;
+                        progress = true;
+                    } else {
+                        lo = mid + step;
+                    }
+                }
+            }
+        }
+        free(cand);
+
+        // Leave the generator with the choices of the smallest case.
+        ihct_gen_reserve(g, n);
+        memcpy(g->choices, best, n * sizeof(uint64_t));
+        g->count = n;
+    }
+    free(best);
+
+    // Replay the smallest case once more, to note its input.
+    g->replaying = true;
+    g->noting = true;
+    ihct_property_case(g, proc, result);
+    return shrinks;
+}
+
+static void ihct_gen_free(ihct_gen *g) {
+    for(size_t i = 0; i < g->block_count; i++) free(g->blocks[i]);
+    free(g->blocks);
+    free(g->choices);
+    ihct_strbuf_free(&g->input);
+    free(g);
+}
+
+// Describes a case that failed, along with the values an assertion failed with,
+// if any.
+static char *ihct_property_detail(const ihct_gen *g, const char *values, uint64_t run_seed,
+                                  unsigned shrinks) {
+    ihct_strbuf detail;
+    ihct_strbuf_init(&detail);
+    ihct_strbuf_appendf(&detail, "input: %s\n", g->input.len ? g->input.data : "(none)");
+    if(values) ihct_strbuf_appendf(&detail, "%s\n", values);
+    ihct_strbuf_appendf(&detail, "case %lu, shrunk %u times; replay with --seed=%#llx",
+        g->index, shrinks, (unsigned long long)run_seed);
+    // Handed over to the result, which frees it.
+    return detail.data;
+}
+
+void ihct_property_run(ihct_property_proc proc, ihct_test_result *result, uint64_t seed,
+                       uint64_t run_seed, unsigned long first, unsigned long count,
+                       void (*pause)(bool)) {
+    ihct_gen *g = calloc(1, sizeof(*g));
+    if(!g) {
+        printf("Couldn't allocate memory for property.\n");
+        exit(EXIT_FAILURE);
+    }
+    ihct_strbuf_init(&g->input);
+    g->pause = pause;
+    running_gen = g;
+
+    *result = (ihct_test_result){.status = PASS};
+    for(unsigned long i = first; i < first + count; i++) {
+        // Every case has a generator of its own, seeded by its index.
+        uint64_t x = seed ^ (i * 0xd1342543de82ef95ULL);
+        for(int k = 0; k < 4; k++) g->s[k] = ihct_splitmix64(&x);
+        g->replaying = false;
+        g->index = i;
+        if(ihct_property_case(g, proc, result)) continue;
+
+        unsigned shrinks = ihct_property_shrink(g, proc, result);
+        if(pause) pause(true);
+        char *values = result->detail;
+        result->detail = ihct_property_detail(g, values, run_seed, shrinks);
+        free(values);
+        if(pause) pause(false);
+        break;
+    }
+
+    running_gen = NULL;
+    ihct_gen_free(g);
+}
+
+char *ihct_property_crashed(uint64_t run_seed) {
+    ihct_gen *g = running_gen;
+    if(!g) return NULL;
+    running_gen = NULL;
+    // The memory of the case isn't freed; it can't be trusted anymore. Neither
+    // is its input noted, unless it crashed while shrinking.
+    ihct_strbuf detail;
+    ihct_strbuf_init(&detail);
+    if(g->noting) ihct_strbuf_appendf(&detail, "input: %s\n", g->input.data);
+    ihct_strbuf_appendf(&detail, "crashed in case %lu; replay with --seed=%#llx", g->index,
+                        (unsigned long long)run_seed);
+    free(g->choices);
+    ihct_strbuf_free(&g->input);
+    free(g);
+    return detail.data;
+}
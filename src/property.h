@@ -0,0 +1,35 @@
+#ifndef IHCT_PROPERTY_H
+#define IHCT_PROPERTY_H
+
+#include "ihct.h"
+
+#include <stdint.h>
+
+// Most cases of a property run by one unit.
+#define IHCT_PROPERTY_SLICE 1000
+
+// Most times a failing case is replayed while shrinking it.
+#define IHCT_PROPERTY_SHRINK_LIMIT 5000
+
+// How far before the choices removed while shrinking a choice is made smaller
+// along with it.
+#define IHCT_PROPERTY_SHRINK_REACH 16
+
+// Returns the seed of a property, given the seed of the run and the name of one
+// of its units. Every unit of a property ('name/3') gets the seed of the
+// property, so that a case only depends on its index.
+uint64_t ihct_property_seed(uint64_t run_seed, const char *name);
+
+// Checks cases first to first + count - 1 of a property, and stops at the first
+// failing one. It is shrunk, and the result gets a detail showing its input.
+// The detail outlives the unit; it is allocated between calls to pause(true)
+// and pause(false), to not be counted against it.
+void ihct_property_run(ihct_property_proc proc, ihct_test_result *result, uint64_t seed,
+                       uint64_t run_seed, unsigned long first, unsigned long count,
+                       void (*pause)(bool));
+
+// Called when the calling thread crashed, possibly within a property. Returns
+// the detail of the case it crashed in, or NULL if it wasn't running one.
+char *ihct_property_crashed(uint64_t run_seed);
+
+#endif
@@ -0,0 +1,202 @@
+#include "reporter.h"
+
+#include <string.h>
+
+const char ihct_reporter_names[] = "junit, jsonl, tap";
+
+// The name of a status, as reported.
+static const char *ihct_report_status(const ihct_report_unit *u) {
+    if(!u->result) return u->cached ? "cached" : "skipped";
+    switch(u->result->status) {
+    case PASS: return "pass";
+    case FAIL: return "fail";
+    case FAIL_FORCE: return "fail";
+    case ERR: return "error";
+    case TIMEOUT: return "timeout";
+    case REGRESSION: return "regression";
+    }
+    return "unknown";
+}
+
+// What went wrong with a unit that didn't pass, in a few words.
+static const char *ihct_report_message(const ihct_test_result *result) {
+    switch(result->status) {
+    case FAIL: return result->code;
+    case FAIL_FORCE: return "forcefully failed";
+    case ERR: return result->code;
+    case TIMEOUT: return "timed out";
+    case REGRESSION: return "regressed against baseline";
+    default: return "";
+    }
+}
+
+// Whether the failure of a result has a location.
+static bool ihct_report_located(const ihct_test_result *result) {
+    return (result->status == FAIL || result->status == FAIL_FORCE) && result->file;
+}
+
+static void ihct_xml_escape(FILE *out, const char *s) {
+    for(; s && *s; s++) {
+        switch(*s) {
+        case '<': fputs("&lt;", out); break;
+        case '>': fputs("&gt;", out); break;
+        case '&': fputs("&amp;", out); break;
+        case '"': fputs("&quot;", out); break;
+        case '\'': fputs("&apos;", out); break;
+        case '\t': case '\n': case '\r': putc(*s, out); break;
+        default:
+            // Other control characters (such as colors) can't be in XML at all,
+            // not even escaped.
+            if((unsigned char)*s < 0x20) fputs("&#xfffd;", out);
+            else putc(*s, out);
+        }
+    }
+}
+
+static void ihct_json_string(FILE *out, const char *s) {
+    putc('"', out);
+    for(; s && *s; s++) {
+        unsigned char c = *s;
+        if(c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if(c == '\n') fputs("\\n", out);
+        else if(c == '\t') fputs("\\t", out);
+        else if(c < 0x20) fprintf(out, "\\u%04x", c);
+        else putc(c, out);
+    }
+    putc('"', out);
+}
+
+// JUnit XML. Units are test cases of a single test suite, with the file they
+// are defined in as class name. Counts are left out of the suite, since they
+// aren't known until the end.
+static void ihct_junit_begin(FILE *out, unsigned count) {
+    (void)count;
+    fputs("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n<testsuite name=\"ihct\">\n",
+          out);
+}
+
+static void ihct_junit_unit(FILE *out, const ihct_report_unit *u) {
+    fputs("  <testcase name=\"", out);
+    ihct_xml_escape(out, u->unit->name);
+    fputs("\" classname=\"", out);
+    ihct_xml_escape(out, u->unit->file ? u->unit->file : "ihct");
+    fprintf(out, "\" time=\"%.6f\"", u->wall);
+
+    const ihct_test_result *r = u->result;
+    if(!r || r->status == PASS) {
+        if(r) fputs("/>\n", out);
+        else fprintf(out, "><skipped message=\"%s\"/></testcase>\n",
+                     u->cached ? "unchanged" : "not run");
+        return;
+    }
+    bool error = r->status == ERR || r->status == TIMEOUT;
+    fprintf(out, ">\n    <%s type=\"%s\" message=\"", error ? "error" : "failure",
+            ihct_report_status(u));
+    ihct_xml_escape(out, ihct_report_message(r));
+    fputs("\">", out);
+    if(ihct_report_located(r)) {
+        ihct_xml_escape(out, r->file);
+        fprintf(out, ":%lu", r->line);
+    }
+    if(r->detail) {
+        fputs("\n", out);
+        ihct_xml_escape(out, r->detail);
+    }
+    fprintf(out, "</%s>\n  </testcase>\n", error ? "error" : "failure");
+}
+
+static void ihct_junit_end(FILE *out, const ihct_report_totals *totals) {
+    (void)totals;
+    fputs("</testsuite>\n</testsuites>\n", out);
+}
+
+// JSON Lines. One object per line: a start event, one for every unit, and an
+// end event with the totals.
+static void ihct_jsonl_begin(FILE *out, unsigned count) {
+    fprintf(out, "{\"event\":\"start\",\"units\":%u}\n", count);
+}
+
+static void ihct_jsonl_unit(FILE *out, const ihct_report_unit *u) {
+    fputs("{\"event\":\"unit\",\"name\":", out);
+    ihct_json_string(out, u->unit->name);
+    fputs(",\"file\":", out);
+    ihct_json_string(out, u->unit->file);
+    fprintf(out, ",\"line\":%lu,\"status\":\"%s\",\"duration\":%.6f",
+            u->unit->line, ihct_report_status(u), u->wall);
+    if(u->ns_per_op > 0) fprintf(out, ",\"ns_per_op\":%.3f", u->ns_per_op);
+
+    const ihct_test_result *r = u->result;
+    if(r && r->status != PASS) {
+        fputs(",\"failure\":{\"message\":", out);
+        ihct_json_string(out, ihct_report_message(r));
+        if(ihct_report_located(r)) {
+            fputs(",\"file\":", out);
+            ihct_json_string(out, r->file);
+            fprintf(out, ",\"line\":%lu", r->line);
+        }
+        if(r->detail) {
+            fputs(",\"detail\":", out);
+            ihct_json_string(out, r->detail);
+        }
+        fputs("}", out);
+    }
+    fputs("}\n", out);
+}
+
+static void ihct_jsonl_end(FILE *out, const ihct_report_totals *t) {
+    fprintf(out, "{\"event\":\"end\",\"units\":%u,\"passed\":%u,\"failed\":%u,\"skipped\":%u,"
+            "\"cached\":%u,\"duration\":%.6f,\"seed\":%llu}\n", t->units, t->passed, t->failed,
+            t->skipped, t->cached, t->elapsed, (unsigned long long)t->seed);
+}
+
+// TAP version 13. The plan comes first when the number of units is known, and
+// last otherwise; units not run are skipped, and failures get a YAML block.
+static bool tap_plan_last;
+
+static void ihct_tap_begin(FILE *out, unsigned count) {
+    fputs("TAP version 13\n", out);
+    tap_plan_last = count == 0;
+    if(!tap_plan_last) fprintf(out, "1..%u\n", count);
+}
+
+static void ihct_tap_yaml_line(FILE *out, const char *key, const char *value) {
+    fprintf(out, "  %s: ", key);
+    ihct_json_string(out, value);
+    fputs("\n", out);
+}
+
+static void ihct_tap_unit(FILE *out, const ihct_report_unit *u) {
+    const ihct_test_result *r = u->result;
+    bool ok = !r || r->status == PASS;
+    fprintf(out, "%s %u - %s", ok ? "ok" : "not ok", u->index + 1, u->unit->name);
+    if(!r) fprintf(out, " # SKIP %s", u->cached ? "unchanged" : "not run");
+    fputs("\n", out);
+    if(ok) return;
+
+    fputs("  ---\n", out);
+    ihct_tap_yaml_line(out, "message", ihct_report_message(r));
+    ihct_tap_yaml_line(out, "severity", ihct_report_status(u));
+    if(ihct_report_located(r)) {
+        ihct_tap_yaml_line(out, "file", r->file);
+        fprintf(out, "  line: %lu\n", r->line);
+    }
+    if(r->detail) ihct_tap_yaml_line(out, "detail", r->detail);
+    fprintf(out, "  duration_ms: %.3f\n  ...\n", u->wall * 1e3);
+}
+
+static void ihct_tap_end(FILE *out, const ihct_report_totals *totals) {
+    if(tap_plan_last) fprintf(out, "1..%u\n", totals->units);
+}
+
+static const ihct_reporter reporters[] = {
+    {"junit", ihct_junit_begin, ihct_junit_unit, ihct_junit_end},
+    {"jsonl", ihct_jsonl_begin, ihct_jsonl_unit, ihct_jsonl_end},
+    {"tap", ihct_tap_begin, ihct_tap_unit, ihct_tap_end},
+};
+
+const ihct_reporter *ihct_reporter_find(const char *name) {
+    for(size_t i = 0; i < sizeof(reporters) / sizeof(reporters[0]); i++) {
+        if(!strcmp(reporters[i].name, name)) return &reporters[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef IHCT_REPORTER_H
+#define IHCT_REPORTER_H
+
+#include "ihct.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+// A unit as reported, once it is done. Units are reported in the order they are
+// run, numbered from 0.
+typedef struct {
+    unsigned index;
+    const ihct_unit *unit;
+    // The result, or NULL if the unit wasn't run. Cached is set if that was
+    // because it passed before and hasn't changed since.
+    const ihct_test_result *result;
+    bool cached;
+    // Wall time taken, in seconds.
+    double wall;
+    // Median time per iteration of a benchmark, in nanoseconds, or 0.
+    double ns_per_op;
+} ihct_report_unit;
+
+// Totals of a run, reported at its end.
+typedef struct {
+    unsigned units;
+    unsigned passed;
+    unsigned failed;
+    unsigned skipped;
+    unsigned cached;
+    double elapsed;
+    uint64_t seed;
+} ihct_report_totals;
+
+// A machine-readable format results are written in, as they get done. Output
+// is only ever appended to, so it can be read while the run is going on.
+typedef struct {
+    const char *name;
+    // Called before the first unit, given the number of units to be reported,
+    // or 0 if not known beforehand.
+    void (*begin)(FILE *out, unsigned count);
+    void (*unit)(FILE *out, const ihct_report_unit *u);
+    void (*end)(FILE *out, const ihct_report_totals *totals);
+} ihct_reporter;
+
+// Finds the reporter with the given name, or returns NULL.
+const ihct_reporter *ihct_reporter_find(const char *name);
+
+// The names of every reporter, separated by commas.
+extern const char ihct_reporter_names[];
+
+#endif
@@ -0,0 +1,238 @@
+#define _GNU_SOURCE
+#include "ihct.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <time.h>
+#include <unistd.h>
+
+// Runs the units of test suites built as shared objects, all in a single run
+// sharing its workers and summary. With --watch, a suite is reloaded whenever
+// it is rebuilt, and its units are run again.
+//
+//     ihct-runner [--watch] suite.so... [-- options of the run]
+
+// How long a rebuilt suite has to stay unchanged before it is reloaded, in
+// milliseconds. Linkers may write a file more than once.
+#define IHCT_RUNNER_SETTLE 50
+
+typedef struct {
+    // The suite as given, and its absolute path.
+    const char *name;
+    char *path;
+    void *handle;
+    // When watching, a suite is loaded from a copy of its own, so that it can
+    // be rebuilt while loaded, and a rebuilt one is a new object to dlopen.
+    char *copy;
+    int watch;
+    bool changed;
+} ihct_suite;
+
+static volatile sig_atomic_t stopping;
+
+static void ihct_runner_interrupt(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static double ihct_runner_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+// Copies a suite to a new temporary file. Returns its path, or NULL.
+static char *ihct_runner_copy(const char *path) {
+    const char *dir = getenv("TMPDIR");
+    char *copy;
+    if(asprintf(&copy, "%s/ihct-runner-XXXXXX.so", dir ? dir : "/tmp") < 0) {
+        printf("Couldn't allocate memory for suite.\n");
+        exit(EXIT_FAILURE);
+    }
+    int out = mkstemps(copy, 3);
+    int in = open(path, O_RDONLY | O_CLOEXEC);
+    bool ok = out >= 0 && in >= 0;
+    char buf[1 << 16];
+    ssize_t n;
+    while(ok && (n = read(in, buf, sizeof(buf))) != 0) {
+        if(n < 0 && errno == EINTR) continue;
+        ok = n > 0 && write(out, buf, n) == n;
+    }
+    if(in >= 0) close(in);
+    if(out >= 0) close(out);
+    if(!ok) {
+        printf("couldn't copy suite '%s': %s.\n", path, strerror(errno));
+        if(out >= 0) unlink(copy);
+        free(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+static bool ihct_runner_load(ihct_suite *s, bool watching) {
+    const char *path = s->path;
+    if(watching) {
+        s->copy = ihct_runner_copy(s->path);
+        if(!s->copy) return false;
+        path = s->copy;
+    }
+    s->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if(!s->handle) {
+        printf("couldn't load suite '%s': %s.\n", s->name, dlerror());
+        if(s->copy) unlink(s->copy);
+        free(s->copy);
+        s->copy = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Unloads a suite. Its units unregister themselves as it is unloaded.
+static void ihct_runner_unload(ihct_suite *s) {
+    if(s->handle) dlclose(s->handle);
+    s->handle = NULL;
+    if(s->copy) unlink(s->copy);
+    free(s->copy);
+    s->copy = NULL;
+}
+
+// Runs the selected units. The arguments are copied, since parsing them
+// reorders them.
+static int ihct_runner_run(int argc, char **argv) {
+    char **args = malloc((argc + 1) * sizeof(*args));
+    if(!args) {
+        printf("Couldn't allocate memory for arguments.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(args, argv, (argc + 1) * sizeof(*args));
+    int status = ihct_run(argc, args);
+    free(args);
+    return status;
+}
+
+// Watches the directories of the suites, and reloads and runs every suite
+// rebuilt, until interrupted. Returns the status of the last run.
+static int ihct_runner_watch(ihct_suite *suites, size_t count, int argc, char **argv,
+                             int status) {
+    int fd = inotify_init1(IN_CLOEXEC);
+    if(fd < 0) {
+        printf("couldn't watch suites: %s.\n", strerror(errno));
+        return status;
+    }
+    // Linkers either write the file in place, or move a new one over it.
+    for(size_t i = 0; i < count; i++) {
+        char *dir = strdup(suites[i].path);
+        suites[i].watch = inotify_add_watch(fd, dirname(dir), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if(suites[i].watch < 0) {
+            printf("couldn't watch suite '%s': %s.\n", suites[i].name, strerror(errno));
+        }
+        free(dir);
+    }
+    printf("watching %zu suites for changes; interrupt to stop.\n", count);
+    fflush(stdout);
+
+    bool pending = false;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while(!stopping) {
+        struct pollfd p = {fd, POLLIN, 0};
+        int ready = poll(&p, 1, pending ? IHCT_RUNNER_SETTLE : -1);
+        if(ready < 0) continue;
+        if(ready > 0) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            for(char *e = buf; n > 0 && e < buf + n;) {
+                const struct inotify_event *ev = (const struct inotify_event *)e;
+                for(size_t i = 0; i < count && ev->len; i++) {
+                    char *base = strrchr(suites[i].path, '/') + 1;
+                    if(suites[i].watch == ev->wd && !strcmp(base, ev->name)) {
+                        suites[i].changed = pending = true;
+                    }
+                }
+                e += sizeof(*ev) + ev->len;
+            }
+            continue;
+        }
+
+        // Settled; reload what changed, and run only its units.
+        pending = false;
+        bool any = false;
+        for(size_t i = 0; i < count; i++) {
+            if(!suites[i].changed) continue;
+            suites[i].changed = false;
+            double begin = ihct_runner_ms();
+            ihct_runner_unload(&suites[i]);
+            if(!ihct_runner_load(&suites[i], true)) continue;
+            printf("\nreloaded '%s' in %.1f ms.\n", suites[i].name, ihct_runner_ms() - begin);
+            ihct_select_module(suites[i].handle);
+            any = true;
+        }
+        fflush(stdout);
+        if(any) status = ihct_runner_run(argc, argv);
+        ihct_select_module(NULL);
+    }
+    close(fd);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    bool watching = false;
+    ihct_suite *suites = calloc(argc, sizeof(*suites));
+    char **args = calloc(argc + 1, sizeof(*args));
+    if(!suites || !args) {
+        printf("Couldn't allocate memory for suites.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t count = 0;
+    int arg_count = 1;
+    args[0] = argv[0];
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--")) {
+            while(++i < argc) args[arg_count++] = argv[i];
+        } else if(!strcmp(argv[i], "--watch")) {
+            watching = true;
+        } else if(argv[i][0] == '-') {
+            printf("unknown option '%s'.\n", argv[i]);
+            exit(EXIT_FAILURE);
+        } else {
+            suites[count].name = argv[i];
+            suites[count].path = realpath(argv[i], NULL);
+            if(!suites[count].path) {
+                printf("couldn't find suite '%s'.\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            count++;
+        }
+    }
+    if(!count) {
+        printf("usage: %s [--watch] suite.so... [-- options]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    // Interrupting a watch finishes the run going on, and cleans up the copies.
+    if(watching) {
+        struct sigaction interrupt = {.sa_handler = &ihct_runner_interrupt};
+        sigemptyset(&interrupt.sa_mask);
+        sigaction(SIGINT, &interrupt, NULL);
+    }
+    for(size_t i = 0; i < count; i++) {
+        if(!ihct_runner_load(&suites[i], watching) && !watching) exit(EXIT_FAILURE);
+    }
+    int status = ihct_runner_run(arg_count, args);
+    if(watching) status = ihct_runner_watch(suites, count, arg_count, args, status);
+
+    for(size_t i = 0; i < count; i++) {
+        ihct_runner_unload(&suites[i]);
+        free(suites[i].path);
+    }
+    free(suites);
+    free(args);
+    return status;
+}
@@ -0,0 +1,82 @@
+#include "stats.h"
+
+#include <math.h>
+#include <stdio.h>
+
+static int ihct_stats_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void ihct_stats_sort(double *v, size_t n) {
+    qsort(v, n, sizeof(*v), ihct_stats_cmp);
+}
+
+double ihct_stats_median(const double *sorted, size_t n) {
+    if(n == 0) return 0;
+    if(n % 2) return sorted[n / 2];
+    return (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+double ihct_stats_mad(const double *v, size_t n, double m) {
+    if(n == 0) return 0;
+    double *dev = malloc(n * sizeof(*dev));
+    if(!dev) {
+        printf("Couldn't allocate memory for statistics.\n");
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < n; i++) dev[i] = fabs(v[i] - m);
+    ihct_stats_sort(dev, n);
+    double mad = ihct_stats_median(dev, n);
+    free(dev);
+    return mad;
+}
+
+// A sample, and which of the two compared sets it belongs to.
+struct ihct_stats_ranked {
+    double value;
+    int set;
+};
+
+static int ihct_stats_ranked_cmp(const void *a, const void *b) {
+    double x = ((const struct ihct_stats_ranked *)a)->value;
+    double y = ((const struct ihct_stats_ranked *)b)->value;
+    return (x > y) - (x < y);
+}
+
+double ihct_stats_mann_whitney(const double *a, size_t na, const double *b, size_t nb) {
+    size_t n = na + nb;
+    if(na == 0 || nb == 0) return 1;
+
+    struct ihct_stats_ranked *all = malloc(n * sizeof(*all));
+    if(!all) {
+        printf("Couldn't allocate memory for statistics.\n");
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < na; i++) all[i] = (struct ihct_stats_ranked){a[i], 0};
+    for(size_t i = 0; i < nb; i++) all[na + i] = (struct ihct_stats_ranked){b[i], 1};
+    qsort(all, n, sizeof(*all), ihct_stats_ranked_cmp);
+
+    // Sum the ranks of a, giving tied values the average of their ranks.
+    double rank_sum = 0, ties = 0;
+    for(size_t i = 0, j; i < n; i = j) {
+        for(j = i + 1; j < n && all[j].value == all[i].value; j++);
+        double rank = (i + 1 + j) / 2.0;
+        for(size_t k = i; k < j; k++) {
+            if(all[k].set == 0) rank_sum += rank;
+        }
+        double t = j - i;
+        ties += t * t * t - t;
+    }
+    free(all);
+
+    double u = rank_sum - na * (na + 1) / 2.0;
+    double mean = na * (double)nb / 2;
+    double var = na * (double)nb / 12 * ((n + 1) - ties / (n * (double)(n - 1)));
+    if(var <= 0) return 1;
+
+    // Continuity corrected.
+    double z = (fabs(u - mean) - 0.5) / sqrt(var);
+    if(z < 0) z = 0;
+    return erfc(z / sqrt(2));
+}
@@ -0,0 +1,20 @@
+#ifndef IHCT_STATS_H
+#define IHCT_STATS_H
+
+#include <stdlib.h>
+
+// Sorts n values in ascending order.
+void ihct_stats_sort(double *v, size_t n);
+
+// Returns the median of n sorted values.
+double ihct_stats_median(const double *sorted, size_t n);
+
+// Returns the median absolute deviation of n values from their median m.
+double ihct_stats_mad(const double *v, size_t n, double m);
+
+// Returns the two-sided p-value of a Mann-Whitney U test, the probability of
+// samples a and b differing as much as they do if they came from the same
+// distribution. Uses the normal approximation, corrected for ties.
+double ihct_stats_mann_whitney(const double *a, size_t na, const double *b, size_t nb);
+
+#endif
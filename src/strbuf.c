@@ -0,0 +1,77 @@
+#include "strbuf.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+void ihct_strbuf_init(ihct_strbuf *b) {
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+}
+
+// Ensures room for n more bytes, plus a terminating null.
+static void ihct_strbuf_reserve(ihct_strbuf *b, size_t n) {
+    if(b->len + n + 1 <= b->cap) return;
+
+    size_t cap = b->cap ? b->cap : 256;
+    while(cap < b->len + n + 1) cap *= 2;
+    char *p = realloc(b->data, cap);
+    if(p == NULL) {
+        printf("Couldn't allocate memory for string buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+    b->data = p;
+    b->cap = cap;
+}
+
+void ihct_strbuf_append(ihct_strbuf *b, const char *s) {
+    ihct_strbuf_appendn(b, s, strlen(s));
+}
+
+void ihct_strbuf_appendn(ihct_strbuf *b, const char *s, size_t n) {
+    ihct_strbuf_reserve(b, n);
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+}
+
+void ihct_strbuf_appendf(ihct_strbuf *b, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    ihct_strbuf_vappendf(b, fmt, args);
+    va_end(args);
+}
+
+void ihct_strbuf_vappendf(ihct_strbuf *b, const char *fmt, va_list args) {
+    va_list again;
+    // Format straight into the spare room; only if it doesn't fit, grow and
+    // format again.
+    ihct_strbuf_reserve(b, 0);
+    size_t room = b->cap - b->len;
+    va_copy(again, args);
+    int n = vsnprintf(b->data + b->len, room, fmt, args);
+    if(n < 0) {
+        va_end(again);
+        return;
+    }
+
+    if((size_t)n >= room) {
+        ihct_strbuf_reserve(b, n);
+        vsnprintf(b->data + b->len, n + 1, fmt, again);
+    }
+    va_end(again);
+    b->len += n;
+}
+
+void ihct_strbuf_flush(ihct_strbuf *b, FILE *f) {
+    if(b->len == 0) return;
+    fwrite(b->data, 1, b->len, f);
+    fflush(f);
+    b->len = 0;
+    b->data[0] = '\0';
+}
+
+void ihct_strbuf_free(ihct_strbuf *b) {
+    free(b->data);
+    ihct_strbuf_init(b);
+}
@@ -0,0 +1,39 @@
+#ifndef IHCT_STRBUF_H
+#define IHCT_STRBUF_H
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Datatype representing an append-only string buffer, growing geometrically so
+// that appends are amortized O(1). To be used internally in IHCT_RUN.
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} ihct_strbuf;
+
+// Initializes an empty buffer. A zeroed buffer is also a valid empty buffer.
+void ihct_strbuf_init(ihct_strbuf *b);
+
+// Appends the string s to the buffer.
+void ihct_strbuf_append(ihct_strbuf *b, const char *s);
+
+// Appends n bytes from s to the buffer.
+void ihct_strbuf_appendn(ihct_strbuf *b, const char *s, size_t n);
+
+// Appends a printf formatted string to the buffer.
+void ihct_strbuf_appendf(ihct_strbuf *b, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Appends a printf formatted string to the buffer, with the arguments in a list.
+void ihct_strbuf_vappendf(ihct_strbuf *b, const char *fmt, va_list args)
+    __attribute__((format(printf, 2, 0)));
+
+// Writes the whole buffer to f in a single call, and empties it.
+void ihct_strbuf_flush(ihct_strbuf *b, FILE *f);
+
+// Deallocates the buffer contents.
+void ihct_strbuf_free(ihct_strbuf *b);
+
+#endif
@@ -9,28 +9,23 @@ ihct_vector *ihct_vector_init() {
         exit(EXIT_FAILURE);
     }
     v->size = 0;
+    v->capacity = 0;
     v->data = NULL;
     return v;
 }
 void ihct_vector_add(ihct_vector *v, void *obj) {
-    if(v->size == 0) {
-        // Allocate a single 
-        v->data = malloc(sizeof(obj));
-        if(v->data == NULL) {
-            printf("Couldn't allocate memory for object.\n");
-            exit(EXIT_FAILURE);
-        }
-        v->data[0] = obj;
-    } else {
-        void *p = realloc(v->data, (v->size + 1) * sizeof(obj));
+    if(v->size == v->capacity) {
+        // Grow geometrically, so adding n objects only copies O(n) pointers.
+        size_t capacity = v->capacity ? v->capacity * 2 : 16;
+        void *p = realloc(v->data, capacity * sizeof(obj));
         if(p == NULL) {
             printf("Couldn't allocate memory for object.\n");
             exit(EXIT_FAILURE);
         }
         v->data = p;
-        v->data[v->size] = obj;
+        v->capacity = capacity;
     }
-    v->size++;
+    v->data[v->size++] = obj;
 }
 void *ihct_vector_get(ihct_vector *v, int index) {
     return v->data[index];
@@ -7,6 +7,7 @@
 typedef struct {
     void **data;
     size_t size;
+    size_t capacity;
 } ihct_vector;
 
 // Allocates a new vector with capacity cap.
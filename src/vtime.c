@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include "vtime.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+// Clocks of a thread with virtual time: the real clocks as they were when it
+// started, and how far they have moved on since, in nanoseconds. Only ever
+// touched by its own thread.
+typedef struct {
+    bool virtual;
+    struct timespec realtime;
+    struct timespec monotonic;
+    uint64_t elapsed;
+} ihct_time_state;
+
+// Initial-exec, as in ihct_alloc; clocks are read far more often than units start.
+static __thread ihct_time_state state __attribute__((tls_model("initial-exec")));
+
+// The functions replaced, as found after this library (in libc), on first use.
+static int (*next_clock_gettime)(clockid_t, struct timespec *);
+static int (*next_gettimeofday)(struct timeval *, void *);
+static time_t (*next_time)(time_t *);
+static int (*next_nanosleep)(const struct timespec *, struct timespec *);
+static int (*next_clock_nanosleep)(clockid_t, int, const struct timespec *, struct timespec *);
+static unsigned (*next_sleep)(unsigned);
+static int (*next_usleep)(useconds_t);
+
+#define IHCT_TIME_NEXT(name)                                                            \
+    ({ __typeof__(next_##name) f = __atomic_load_n(&next_##name, __ATOMIC_RELAXED);     \
+       if(!f) {                                                                         \
+           f = (__typeof__(f))dlsym(RTLD_NEXT, #name);                                  \
+           __atomic_store_n(&next_##name, f, __ATOMIC_RELAXED);                         \
+       }                                                                                \
+       f; })
+
+// The base of a clock that is made virtual, or NULL for one that isn't (such as
+// the cpu time clocks).
+static const struct timespec *ihct_time_base(clockid_t clock) {
+    switch(clock) {
+    case CLOCK_REALTIME:
+    case CLOCK_REALTIME_COARSE:
+        return &state.realtime;
+    case CLOCK_MONOTONIC:
+    case CLOCK_MONOTONIC_RAW:
+    case CLOCK_MONOTONIC_COARSE:
+    case CLOCK_BOOTTIME:
+        return &state.monotonic;
+    default:
+        return NULL;
+    }
+}
+
+static struct timespec ihct_time_now(const struct timespec *base) {
+    uint64_t ns = base->tv_nsec + state.elapsed % 1000000000;
+    struct timespec now = {base->tv_sec + state.elapsed / 1000000000 + ns / 1000000000,
+                           ns % 1000000000};
+    return now;
+}
+
+static bool ihct_time_valid(const struct timespec *ts) {
+    return ts->tv_sec >= 0 && ts->tv_nsec >= 0 && ts->tv_nsec < 1000000000;
+}
+
+void ihct_time_begin(void) {
+    IHCT_TIME_NEXT(clock_gettime)(CLOCK_REALTIME, &state.realtime);
+    IHCT_TIME_NEXT(clock_gettime)(CLOCK_MONOTONIC, &state.monotonic);
+    state.elapsed = 0;
+    state.virtual = true;
+}
+
+void ihct_time_end(void) {
+    state.virtual = false;
+}
+
+void ihct_time_shift(uint64_t ns) {
+    state.elapsed += ns;
+}
+
+int clock_gettime(clockid_t clock, struct timespec *ts) {
+    const struct timespec *base = state.virtual ? ihct_time_base(clock) : NULL;
+    if(!base) return IHCT_TIME_NEXT(clock_gettime)(clock, ts);
+    *ts = ihct_time_now(base);
+    return 0;
+}
+
+// The timezone is obsolete, and left alone.
+int gettimeofday(struct timeval *tv, void *tz) {
+    if(!state.virtual) return IHCT_TIME_NEXT(gettimeofday)(tv, tz);
+    struct timespec now = ihct_time_now(&state.realtime);
+    tv->tv_sec = now.tv_sec;
+    tv->tv_usec = now.tv_nsec / 1000;
+    return 0;
+}
+
+time_t time(time_t *t) {
+    if(!state.virtual) return IHCT_TIME_NEXT(time)(t);
+    time_t now = ihct_time_now(&state.realtime).tv_sec;
+    if(t) *t = now;
+    return now;
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem) {
+    if(!state.virtual) return IHCT_TIME_NEXT(nanosleep)(req, rem);
+    if(!ihct_time_valid(req)) {
+        errno = EINVAL;
+        return -1;
+    }
+    state.elapsed += req->tv_sec * 1000000000ULL + req->tv_nsec;
+    return 0;
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec *req,
+                    struct timespec *rem) {
+    const struct timespec *base = state.virtual ? ihct_time_base(clock) : NULL;
+    if(!base) return IHCT_TIME_NEXT(clock_nanosleep)(clock, flags, req, rem);
+    if(!ihct_time_valid(req)) return EINVAL;
+    uint64_t ns = req->tv_sec * 1000000000ULL + req->tv_nsec;
+    if(flags & TIMER_ABSTIME) {
+        // Sleeping until a time already passed returns at once.
+        struct timespec now = ihct_time_now(base);
+        uint64_t at = now.tv_sec * 1000000000ULL + now.tv_nsec;
+        ns = ns > at ? ns - at : 0;
+    }
+    state.elapsed += ns;
+    return 0;
+}
+
+unsigned sleep(unsigned seconds) {
+    if(!state.virtual) return IHCT_TIME_NEXT(sleep)(seconds);
+    state.elapsed += seconds * 1000000000ULL;
+    return 0;
+}
+
+int usleep(useconds_t usec) {
+    if(!state.virtual) return IHCT_TIME_NEXT(usleep)(usec);
+    state.elapsed += usec * 1000ULL;
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef IHCT_VTIME_H
+#define IHCT_VTIME_H
+
+#include <stdint.h>
+
+// Virtual time. The library ihct_time replaces clock_gettime, gettimeofday,
+// time and the sleeping functions (sleep, usleep, nanosleep, clock_nanosleep).
+// While a thread runs a unit with virtual time, its clocks stand still, and
+// only move on when it sleeps, or the unit advances them; sleeping returns at
+// once. Every other thread, and the watchdog timing out units, keeps real time.
+// Waiting on a condition variable or file descriptors with a timeout isn't
+// virtual. Link a test program with it, or preload it (LD_PRELOAD); the runner
+// finds the functions below at runtime, and fails units with virtual time
+// without them.
+
+// Stops the clocks of the calling thread where they are, starting virtual time.
+void ihct_time_begin(void);
+
+// Gives the calling thread real time again.
+void ihct_time_end(void);
+
+// Moves the clocks of the calling thread on by the given number of nanoseconds.
+void ihct_time_shift(uint64_t ns);
+
+#endif